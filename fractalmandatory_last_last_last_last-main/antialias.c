@@ -0,0 +1,303 @@
+#include "fract.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+** A pixel is an edge when a neighbour's count differs from its own by more
+** than AA_THRESHOLD; (unsigned)(d + t) > 2t is |d| > t. Neighbours past the
+** image border are the pixel itself.
+*/
+static void	mark_counts(t_fractal *fract, int *slot, int y, int x)
+{
+	const int	*row[3];
+	int			c;
+	int			e;
+
+	row[0] = fract->iters + (y - (y > 0)) * fract->width;
+	row[1] = fract->iters + y * fract->width;
+	row[2] = fract->iters + (y + (y + 1 < fract->height)) * fract->width;
+	while (x < fract->aa.rect[2])
+	{
+		c = row[1][x] + AA_THRESHOLD;
+		e = ((unsigned int)(c - row[0][x]) > 2 * AA_THRESHOLD);
+		e |= ((unsigned int)(c - row[2][x]) > 2 * AA_THRESHOLD);
+		e |= ((unsigned int)(c - row[1][x - (x > 0)]) > 2 * AA_THRESHOLD);
+		e |= ((unsigned int)(c - row[1][x + (x + 1 < fract->width)])
+				> 2 * AA_THRESHOLD);
+		slot[x] = -1 - e;
+		x++;
+	}
+}
+
+/*
+** The same test on the smooth counts, since integer band steps are no
+** longer visible with smooth coloring.
+*/
+static void	mark_smooth(t_fractal *fract, int *slot, int y, int x)
+{
+	const float	*row[3];
+	float		c;
+	int			e;
+
+	row[0] = fract->smooth_iters + (y - (y > 0)) * fract->width;
+	row[1] = fract->smooth_iters + y * fract->width;
+	row[2] = fract->smooth_iters + (y + (y + 1 < fract->height))
+		* fract->width;
+	while (x < fract->aa.rect[2])
+	{
+		c = row[1][x];
+		e = (fabsf(c - row[0][x]) > AA_THRESHOLD);
+		e |= (fabsf(c - row[2][x]) > AA_THRESHOLD);
+		e |= (fabsf(c - row[1][x - (x > 0)]) > AA_THRESHOLD);
+		e |= (fabsf(c - row[1][x + (x + 1 < fract->width)]) > AA_THRESHOLD);
+		slot[x] = -1 - e;
+		x++;
+	}
+}
+
+static void	mark_row(t_fractal *fract, int row)
+{
+	int	y;
+
+	y = fract->aa.rect[1] + row;
+	if (fract->smooth)
+		mark_smooth(fract, fract->aa.slot + y * fract->width, y,
+			fract->aa.rect[0]);
+	else
+		mark_counts(fract, fract->aa.slot + y * fract->width, y,
+			fract->aa.rect[0]);
+}
+
+/*
+** Moves the samples still referenced into iter/smooth (unless they are the
+** current arrays) and numbers the newly marked pixels after them.
+*/
+static void	assign_slots(t_aa *aa, int size, int *iter, float *smooth)
+{
+	int	n[2];
+	int	i;
+
+	n[0] = 0;
+	n[1] = aa->first;
+	i = -1;
+	while (++i < size)
+	{
+		if (aa->slot[i] >= 0)
+		{
+			memcpy(iter + n[0] * AA_SAMPLES, aa->iter + aa->slot[i]
+				* AA_SAMPLES, AA_SAMPLES * sizeof(int));
+			memcpy(smooth + n[0] * AA_SAMPLES, aa->smooth + aa->slot[i]
+				* AA_SAMPLES, AA_SAMPLES * sizeof(float));
+			aa->slot[i] = n[0]++;
+		}
+		else if (aa->slot[i] == -2)
+			aa->slot[i] = n[1]++;
+	}
+	if (iter == aa->iter)
+		return ;
+	free(aa->iter);
+	free(aa->smooth);
+	aa->iter = iter;
+	aa->smooth = smooth;
+	aa->capacity = n[1];
+}
+
+/*
+** Gives every newly marked pixel a place in the sample store, after the
+** samples earlier passes left for pixels that are still edges. Those are
+** compacted into fresh arrays, since panning leaves samples behind for
+** pixels that moved off screen.
+*/
+static int	store_samples(t_aa *aa, int size)
+{
+	int		*iter;
+	float	*smooth;
+	int		n[2];
+	int		i;
+
+	n[0] = 0;
+	n[1] = 0;
+	i = -1;
+	while (++i < size)
+		n[aa->slot[i] == -2] += aa->slot[i] != -1;
+	aa->first = n[0];
+	aa->count = n[0] + n[1];
+	if (n[0] == 0 && n[1] <= aa->capacity)
+	{
+		assign_slots(aa, size, aa->iter, aa->smooth);
+		return (0);
+	}
+	iter = malloc((size_t)aa->count * AA_SAMPLES * sizeof(int));
+	smooth = malloc((size_t)aa->count * AA_SAMPLES * sizeof(float));
+	if (!iter || !smooth)
+	{
+		printf("Error: Cannot allocate %d anti-aliasing samples\n",
+			aa->count * AA_SAMPLES);
+		free(iter);
+		free(smooth);
+		return (1);
+	}
+	assign_slots(aa, size, iter, smooth);
+	return (0);
+}
+
+/*
+** Stores the counts of a full batch of samples; dst holds the store index
+** of each one.
+*/
+static void	flush_samples(t_fractal *fract, t_batch *b, int *dst)
+{
+	int	i;
+
+	run_batch(fract, b);
+	i = 0;
+	while (i < b->n)
+	{
+		fract->aa.iter[dst[i]] = b->iter[i];
+		fract->aa.smooth[dst[i]] = b->smooth[i];
+		i++;
+	}
+	b->n = 0;
+}
+
+/*
+** Sample k of a pixel sits at ((4i + j + 0.5) / 16, (4j + i + 0.5) / 16)
+** of its square, i = k / 4 and j = k % 4: a 4x4 grid sheared so that no
+** two samples share a row or a column of the 16x16 subpixel grid, which
+** resolves near horizontal and vertical edges in 16 steps instead of 4.
+** The four with i = (j + 2) % 4 form a rotated grid of their own and are
+** queued by stage pos[2] = 0; stage 1 queues the other twelve, only for
+** pixels whose first four samples disagree with the pixel's count.
+*/
+static void	queue_samples(t_fractal *fract, t_batch *b, int *dst, int pos[3])
+{
+	double	c[2];
+	int		k;
+
+	k = 0;
+	while (k < AA_SAMPLES)
+	{
+		if ((k / 4 == (k % 4 + 2) % 4) == (pos[2] == 0))
+		{
+			c[0] = fract->min_re + (pos[0] + (4 * (k / 4) + k % 4 + 0.5)
+					/ 16.0 - 0.5) * fract->factors[0];
+			c[1] = fract->max_im - (pos[1] + (4 * (k % 4) + k / 4 + 0.5)
+					/ 16.0 - 0.5) * fract->factors[1];
+			dst[b->n] = fract->aa.slot[pos[1] * fract->width + pos[0]]
+				* AA_SAMPLES + k;
+			fract->formula->load(fract, b, b->n++, c);
+			if (b->n == BATCH_SIZE)
+				flush_samples(fract, b, dst);
+		}
+		k++;
+	}
+}
+
+/*
+** Returns 0 when the first four samples of the pixel at pos agree with its
+** count, after giving each of the other twelve the value of one of them;
+** 1 when the pixel needs all its samples.
+*/
+static int	needs_samples(t_fractal *fract, int pos[2])
+{
+	t_aa	*aa;
+	double	v[2];
+	int		base;
+	int		k;
+
+	aa = &fract->aa;
+	base = aa->slot[pos[1] * fract->width + pos[0]] * AA_SAMPLES;
+	v[0] = fract->iters[pos[1] * fract->width + pos[0]];
+	if (fract->smooth)
+		v[0] = fract->smooth_iters[pos[1] * fract->width + pos[0]];
+	k = -1;
+	while (++k < 4)
+	{
+		v[1] = aa->iter[base + 4 * k + (k + 2) % 4];
+		if (fract->smooth)
+			v[1] = aa->smooth[base + 4 * k + (k + 2) % 4];
+		if (v[0] - v[1] > AA_THRESHOLD || v[1] - v[0] > AA_THRESHOLD)
+			return (1);
+	}
+	k = -1;
+	while (++k < AA_SAMPLES)
+	{
+		aa->iter[base + k] = aa->iter[base + k / 4 * 4 + (k / 4 + 2) % 4];
+		aa->smooth[base + k] = aa->smooth[base + k / 4 * 4
+			+ (k / 4 + 2) % 4];
+	}
+	return (0);
+}
+
+static void	sample_row(t_fractal *fract, int row)
+{
+	t_batch	b;
+	int		dst[BATCH_SIZE];
+	int		pos[3];
+	int		rect[4];
+
+	init_batch(fract, &b);
+	pos[1] = fract->aa.rect[1] + row;
+	pos[2] = 0;
+	while (pos[2] < 2)
+	{
+		pos[0] = fract->aa.rect[0] - 1;
+		while (++pos[0] < fract->aa.rect[2])
+		{
+			if (fract->aa.slot[pos[1] * fract->width + pos[0]]
+				>= fract->aa.first && (pos[2] == 0
+					|| needs_samples(fract, pos)))
+				queue_samples(fract, &b, dst, pos);
+		}
+		flush_samples(fract, &b, dst);
+		pos[2]++;
+	}
+	rect[0] = fract->aa.rect[0];
+	rect[1] = pos[1];
+	rect[2] = fract->aa.rect[2];
+	rect[3] = pos[1] + 1;
+	color_rect(fract, rect);
+}
+
+/*
+** Adaptive anti-aliasing pass over rect = {x0, y0, x1, y1} of a complete
+** frame: the pixels around it are rechecked too, since their neighbours
+** changed. Edge pixels found in the count buffer are supersampled
+** AA_SAMPLES times and shown as the mean of their samples' colors; the
+** rest keep their single sample. The samples are kept, so recoloring
+** does not iterate them again.
+*/
+void	antialias(t_fractal *fract, int rect[4])
+{
+	t_aa	*aa;
+	long	start;
+
+	start = stats_now();
+	aa = &fract->aa;
+	aa->rect[0] = rect[0] - (rect[0] > 0);
+	aa->rect[1] = rect[1] - (rect[1] > 0);
+	aa->rect[2] = rect[2] + (rect[2] < fract->width);
+	aa->rect[3] = rect[3] + (rect[3] < fract->height);
+	aa->valid = 0;
+	pool_run(fract, mark_row, aa->rect[3] - aa->rect[1]);
+	if (store_samples(aa, fract->width * fract->height) == 0)
+	{
+		aa->valid = 1;
+		pool_run(fract, sample_row, aa->rect[3] - aa->rect[1]);
+	}
+	fract->stats.aa += stats_now() - start;
+}
+
+void	aa_free(t_aa *aa)
+{
+	free(aa->slot);
+	free(aa->iter);
+	free(aa->smooth);
+	aa->slot = NULL;
+	aa->iter = NULL;
+	aa->smooth = NULL;
+	aa->count = 0;
+	aa->capacity = 0;
+	aa->valid = 0;
+}
@@ -0,0 +1,208 @@
+#include "fract.h"
+#include "minilibx-linux/mlx.h"
+#include <string.h>
+
+int	render_pending(t_fractal *fract)
+{
+	return (fract->num_strips > 0 || fract->resume || fract->refine
+		|| fract->aa.pending);
+}
+
+/*
+** Does one step of the pending work: a strip uncovered by a pan, the
+** orbits to continue after max_iter went up, the next pass of the
+** progressive sequence, or the anti-aliasing of a complete
+** frame, timed for the budget. A step cut short by a newer generation
+** stays pending; doing it again from the start is always correct.
+** Half-sampled anti-aliasing is not kept for recoloring.
+*/
+static void	render_step(t_fractal *fract)
+{
+	long	start;
+	int		rect[4];
+
+	start = stats_now();
+	rect[0] = 0;
+	rect[1] = 0;
+	rect[2] = fract->width;
+	rect[3] = fract->height;
+	if (fract->num_strips > 0)
+		render_rect(fract, fract->strips[fract->num_strips - 1]);
+	else if (fract->resume)
+		resume_pass(fract, fract->resume);
+	else if (fract->refine)
+		render_pass(fract, fract->refine, fract->refine < fract->first_pass);
+	else
+		antialias(fract, rect);
+	if (render_cancelled(fract))
+	{
+		if (!fract->num_strips && !fract->resume && !fract->refine)
+			fract->aa.valid = 0;
+		return ;
+	}
+	if (fract->num_strips > 0)
+		fract->num_strips--;
+	else if (fract->resume)
+		fract->resume = next_resume(fract);
+	else if (fract->refine)
+		fract->refine = next_pass(fract, stats_now() - start);
+	else
+		fract->aa.pending = 0;
+	publish(fract);
+}
+
+/*
+** The render thread sleeps until loop_hook() hands it the pending work,
+** then works through it step by step until it is done or cancelled. It
+** never calls MiniLibX; finished steps are published for loop_hook() to
+** put on the window.
+*/
+static void	*render_loop(void *arg)
+{
+	t_fractal	*fract;
+	t_async		*a;
+
+	fract = arg;
+	a = &fract->async;
+	pthread_mutex_lock(&a->lock);
+	while (1)
+	{
+		while (!a->quit && !a->busy)
+			pthread_cond_wait(&a->wake, &a->lock);
+		if (a->quit)
+			break ;
+		pthread_mutex_unlock(&a->lock);
+		while (render_pending(fract) && !render_cancelled(fract))
+			render_step(fract);
+		pthread_mutex_lock(&a->lock);
+		a->busy = 0;
+		pthread_cond_broadcast(&a->idle);
+	}
+	pthread_mutex_unlock(&a->lock);
+	return (NULL);
+}
+
+/*
+** Hands the pending work to the render thread. Only loop_hook() calls it,
+** once the event queue is empty, so a burst of input starts one render.
+*/
+void	start_render(t_fractal *fract)
+{
+	pthread_mutex_lock(&fract->async.lock);
+	fract->async.busy = 1;
+	pthread_cond_signal(&fract->async.wake);
+	pthread_mutex_unlock(&fract->async.lock);
+}
+
+/*
+** Called by every hook before it touches the view, the settings or the
+** buffers: bumps the generation, which makes the render thread drop what
+** it is doing, and waits until it has. The thread then stays idle until
+** loop_hook() restarts it, so the hook owns all render state meanwhile.
+*/
+void	stop_render(t_fractal *fract)
+{
+	t_async	*a;
+
+	a = &fract->async;
+	pthread_mutex_lock(&a->lock);
+	__atomic_add_fetch(&a->generation, 1, __ATOMIC_RELAXED);
+	while (a->busy)
+		pthread_cond_wait(&a->idle, &a->lock);
+	a->started = a->generation;
+	pthread_mutex_unlock(&a->lock);
+}
+
+/*
+** Makes the image just drawn the next one for loop_hook() to show and
+** continues in the other one, starting from a copy so that strips and
+** anti-aliasing can update it in place. An older frame loop_hook() has
+** not shown yet is dropped.
+*/
+void	publish(t_fractal *fract)
+{
+	t_async	*a;
+
+	a = &fract->async;
+	pthread_mutex_lock(&a->lock);
+	a->ready = a->back;
+	a->back = !a->back;
+	memcpy(a->addr[a->back], a->addr[a->ready],
+		(size_t)fract->line_len * fract->height);
+	fract->img = a->img[a->back];
+	fract->addr = a->addr[a->back];
+	stats_tick(fract, 0);
+	pthread_mutex_unlock(&a->lock);
+}
+
+/*
+** Replaces both images with ones of the given size. The render thread
+** must be idle.
+*/
+int	async_images(t_fractal *fract, int width, int height)
+{
+	t_async	*a;
+	void	*img[2];
+	int		i;
+
+	a = &fract->async;
+	img[0] = mlx_new_image(fract->mlx, width, height);
+	img[1] = mlx_new_image(fract->mlx, width, height);
+	if (!img[0] || !img[1])
+	{
+		if (img[0])
+			mlx_destroy_image(fract->mlx, img[0]);
+		if (img[1])
+			mlx_destroy_image(fract->mlx, img[1]);
+		return (1);
+	}
+	i = -1;
+	while (++i < 2)
+	{
+		if (a->img[i])
+			mlx_destroy_image(fract->mlx, a->img[i]);
+		a->img[i] = img[i];
+		a->addr[i] = mlx_get_data_addr(img[i], &fract->bpp,
+				&fract->line_len, &fract->endian);
+		memset(a->addr[i], 0, (size_t)fract->line_len * height);
+	}
+	a->back = 0;
+	a->front = 1;
+	a->ready = -1;
+	fract->img = a->img[0];
+	fract->addr = a->addr[0];
+	return (0);
+}
+
+int	async_start(t_fractal *fract)
+{
+	t_async	*a;
+
+	a = &fract->async;
+	pthread_mutex_init(&a->lock, NULL);
+	pthread_cond_init(&a->wake, NULL);
+	pthread_cond_init(&a->idle, NULL);
+	if (pthread_create(&a->thread, NULL, render_loop, fract))
+	{
+		printf("Error: Cannot start the render thread\n");
+		return (1);
+	}
+	a->running = 1;
+	return (0);
+}
+
+void	async_stop(t_fractal *fract)
+{
+	t_async	*a;
+
+	a = &fract->async;
+	if (!a->running)
+		return ;
+	stop_render(fract);
+	pthread_mutex_lock(&a->lock);
+	a->quit = 1;
+	pthread_cond_signal(&a->wake);
+	pthread_mutex_unlock(&a->lock);
+	pthread_join(a->thread, NULL);
+	a->running = 0;
+}
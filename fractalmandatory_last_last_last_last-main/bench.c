@@ -0,0 +1,236 @@
+#include "fract.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct s_result
+{
+	const char	*name;
+	const char	*kernel;
+	int			max_iter;
+	double		mpix;
+	double		giter;
+	double		p50;
+	double		p99;
+	long		checksum;
+	int			threads;
+}	t_result;
+
+static double	now_ms(void)
+{
+	struct timespec	t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec * 1e3 + t.tv_nsec / 1e6);
+}
+
+static int	compare_ms(const void *a, const void *b)
+{
+	return ((*(const double *)a > *(const double *)b)
+		- (*(const double *)a < *(const double *)b));
+}
+
+static const char	*kernel_name(t_fractal *fract)
+{
+	if (fract->deep.active)
+		return ("perturb");
+	if (fract->iterate == fract->kernels[PREC_FLOAT])
+		return ("float");
+	if (fract->iterate == fract->kernels[PREC_LONG])
+		return ("long");
+	return ("double");
+}
+
+/*
+** Renders the view `frames` times after one untimed frame, which builds
+** the palette table and, when deep, the reference orbits. The sum of the
+** per-pixel counts stands for the iterations done, shortcuts included,
+** and doubles as a checksum of the frame.
+*/
+static void	measure(t_fractal *fract, int frames, t_result *r, double *ms)
+{
+	double	t;
+	long	sum;
+	int		i;
+
+	render_image(fract);
+	sum = 0;
+	i = -1;
+	while (++i < fract->width * fract->height)
+		sum += fract->iters[i];
+	t = 0.0;
+	i = -1;
+	while (++i < frames)
+	{
+		ms[i] = now_ms();
+		render_image(fract);
+		ms[i] = now_ms() - ms[i];
+		t += ms[i];
+	}
+	qsort(ms, frames, sizeof(double), compare_ms);
+	r->kernel = kernel_name(fract);
+	r->max_iter = fract->max_iter;
+	r->mpix = (double)fract->width * fract->height * frames / t / 1e3;
+	r->giter = (double)sum * frames / t / 1e6;
+	r->p50 = ms[(frames - 1) / 2];
+	r->p99 = ms[(99 * frames + 99) / 100 - 1];
+	r->checksum = sum;
+}
+
+/*
+** Renders one view of the suite at `size`; views[0] stands for argv[0].
+*/
+static int	run_view(const char **view, const char *size, int frames,
+		t_result *r)
+{
+	t_fractal	fract;
+	t_options	opt;
+	const char	*argv[16];
+	double		*ms;
+	int			argc;
+
+	argc = 0;
+	while (view[argc])
+	{
+		argv[argc] = view[argc];
+		argc++;
+	}
+	argv[argc++] = "--size";
+	argv[argc++] = size;
+	argv[argc] = NULL;
+	r->name = view[0];
+	init_fractal(&fract);
+	ms = malloc(frames * sizeof(double));
+	if (!ms || parse_args(argc, (char **)argv, &fract, &opt)
+		|| alloc_buffer(&fract))
+	{
+		free(ms);
+		return (1);
+	}
+	pool_init(&fract);
+	measure(&fract, frames, r, ms);
+	r->threads = fract.pool.num_threads;
+	pool_destroy(&fract.pool);
+	free(ms);
+	free(fract.addr);
+	free(fract.iters);
+	free(fract.smooth_iters);
+	aa_free(&fract.aa);
+	deep_free(&fract);
+	palette_free(&fract.colors);
+	return (0);
+}
+
+static int	write_json(const char *path, const t_result *r, int n,
+		const char *size)
+{
+	FILE	*file;
+	int		i;
+
+	file = fopen(path, "w");
+	if (!file)
+	{
+		printf("Error: Cannot write '%s'\n", path);
+		return (1);
+	}
+	fprintf(file, "{\n  \"size\": \"%s\",\n  \"threads\": %d,\n"
+		"  \"views\": [\n", size, r[0].threads);
+	i = -1;
+	while (++i < n)
+		fprintf(file, "    {\"name\": \"%s\", \"kernel\": \"%s\", "
+			"\"max_iter\": %d, \"mpixels_per_s\": %.3f, "
+			"\"giterations_per_s\": %.4f, \"p50_ms\": %.3f, "
+			"\"p99_ms\": %.3f, \"checksum\": %ld}%s\n", r[i].name,
+			r[i].kernel, r[i].max_iter, r[i].mpix, r[i].giter, r[i].p50,
+			r[i].p99, r[i].checksum, (i + 1 < n) ? "," : "");
+	fprintf(file, "  ]\n}\n");
+	return (fclose(file) != 0);
+}
+
+static int	bench_options(int argc, char **argv, const char *opt[2],
+		int *frames)
+{
+	const char	*s;
+	int			i;
+
+	opt[0] = BENCH_SIZE;
+	opt[1] = NULL;
+	*frames = BENCH_FRAMES;
+	i = 1;
+	while (i < argc)
+	{
+		s = argv[i + 1];
+		if (s && ft_strcmp(argv[i], "--size") == 0)
+			opt[0] = s;
+		else if (s && ft_strcmp(argv[i], "--json") == 0)
+			opt[1] = s;
+		else if (s && ft_strcmp(argv[i], "--frames") == 0)
+			*frames = (int)is_it_int(&s);
+		else
+			s = NULL;
+		if (!s || *frames < 1 || *frames > 100000
+			|| (ft_strcmp(argv[i], "--frames") == 0 && *s))
+		{
+			printf("Error: Invalid option '%s'\n\n", argv[i]);
+			print_usage();
+			return (1);
+		}
+		i += 2;
+	}
+	return (0);
+}
+
+/*
+** `./fractol bench [--size WxH] [--frames N] [--json FILE]`: renders a
+** fixed suite of views headless, N timed frames each, and reports pixel
+** and iteration throughput with median and 99th percentile frame times,
+** as a table and optionally as JSON for tracking across builds.
+*/
+int	bench(int argc, char **argv)
+{
+	static const char	*views[][12] = {
+	{"overview", "mandelbrot", "--iter", "256", NULL},
+	{"overview-float", "mandelbrot", "--iter", "256", "--precision", "float",
+		NULL},
+	{"overview-double", "mandelbrot", "--iter", "256", "--precision",
+		"double", NULL},
+	{"overview-long", "mandelbrot", "--iter", "256", "--precision", "long",
+		NULL},
+	{"seahorse-valley", "mandelbrot", "--iter", "1000", "--center", "-0.75",
+		"0.1", "--span", "0.05", NULL},
+	{"deep-zoom", "mandelbrot", "--iter", "3000", "--center",
+		"-0.743643887037158704752191506114774",
+		"0.131825904205311970493132056385139", "--span", "1e-13", NULL},
+	{"julia-dendrite", "julia", "0", "1", "--iter", "1000", NULL},
+	{"julia-spiral", "julia", "-0.7269", "0.1889", "--iter", "1000", NULL},
+	{"high-max-iter", "mandelbrot", "--iter", "100000", "--center",
+		"-0.7436", "0.1318", "--span", "0.002", NULL},
+	{"burning-ship", "burning_ship", "--iter", "1000", "--center", "-1.76",
+		"-0.03", "--span", "0.1", NULL},
+	{"multibrot-3", "multibrot", "--iter", "1000", NULL},
+	{"tricorn", "tricorn", "--iter", "1000", NULL},
+	{"newton", "newton", "--iter", "100", NULL}};
+	t_result			r[sizeof(views) / sizeof(views[0])];
+	const char			*opt[2];
+	int					frames;
+	int					n;
+
+	if (bench_options(argc, argv, opt, &frames))
+		return (1);
+	printf("%-16s %-8s %8s %9s %9s %9s %9s\n", "view", "kernel",
+		"max_iter", "Mpix/s", "Giter/s", "p50 ms", "p99 ms");
+	n = 0;
+	while (n < (int)(sizeof(views) / sizeof(views[0])))
+	{
+		if (run_view(views[n], opt[0], frames, r + n))
+			return (1);
+		printf("%-16s %-8s %8d %9.2f %9.3f %9.2f %9.2f\n", r[n].name,
+			r[n].kernel, r[n].max_iter, r[n].mpix, r[n].giter, r[n].p50,
+			r[n].p99);
+		fflush(stdout);
+		n++;
+	}
+	if (opt[1])
+		return (write_json(opt[1], r, n, opt[0]));
+	return (0);
+}
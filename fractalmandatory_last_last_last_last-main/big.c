@@ -0,0 +1,158 @@
+#include "fract.h"
+#include <math.h>
+
+void	big_from_double(t_big *r, double x)
+{
+	int	i;
+
+	r->neg = x < 0.0;
+	x = fabs(x);
+	i = 0;
+	while (i < BIG_LIMBS)
+	{
+		r->limb[i] = (unsigned int)x;
+		x = (x - r->limb[i]) * 4294967296.0;
+		i++;
+	}
+}
+
+double	big_to_double(const t_big *a)
+{
+	double	x;
+	int		i;
+
+	x = 0.0;
+	i = BIG_LIMBS;
+	while (i-- > 0)
+		x = x / 4294967296.0 + a->limb[i];
+	if (a->neg)
+		return (-x);
+	return (x);
+}
+
+/*
+** Exact decimal parsing for --center, so a deep view is not rounded to the
+** nearest double first: the fraction is built from its last digit up as
+** f = (f + digit) / 10. Exponent notation falls back to ft_atof().
+*/
+void	big_from_str(t_big *r, const char *s)
+{
+	unsigned long long	rem;
+	const char			*p;
+	const char			*end;
+	int					i;
+
+	big_from_double(r, 0.0);
+	p = s + (*s == '-' || *s == '+');
+	end = p;
+	while ((*end >= '0' && *end <= '9') || *end == '.')
+		end++;
+	if (*end != '\0')
+	{
+		big_from_double(r, ft_atof(s));
+		return ;
+	}
+	while (--end >= p && *end != '.')
+	{
+		r->limb[0] += *end - '0';
+		rem = 0;
+		i = 0;
+		while (i < BIG_LIMBS)
+		{
+			rem = (rem << 32) | r->limb[i];
+			r->limb[i++] = (unsigned int)(rem / 10);
+			rem %= 10;
+		}
+	}
+	if (end < p)
+		big_from_double(r, 0.0);
+	while (*p >= '0' && *p <= '9')
+		r->limb[0] = r->limb[0] * 10 + (*p++ - '0');
+	r->neg = (*s == '-');
+}
+
+static void	add_magnitude(t_big *r, const t_big *a, const t_big *b, int sub)
+{
+	unsigned long long	t;
+	unsigned long long	carry;
+	int					i;
+
+	carry = 0;
+	i = BIG_LIMBS;
+	while (i-- > 0)
+	{
+		if (sub)
+		{
+			t = (unsigned long long)a->limb[i] - b->limb[i] - carry;
+			carry = t >> 63;
+		}
+		else
+		{
+			t = (unsigned long long)a->limb[i] + b->limb[i] + carry;
+			carry = t >> 32;
+		}
+		r->limb[i] = (unsigned int)t;
+	}
+}
+
+/*
+** r = a + b; r may alias either operand.
+*/
+void	big_add(t_big *r, const t_big *a, const t_big *b)
+{
+	int	i;
+
+	i = 0;
+	while (i < BIG_LIMBS - 1 && a->limb[i] == b->limb[i])
+		i++;
+	if (a->neg == b->neg)
+		add_magnitude(r, a, b, 0);
+	else if (a->limb[i] >= b->limb[i])
+		add_magnitude(r, a, b, 1);
+	else
+	{
+		r->neg = b->neg;
+		add_magnitude(r, b, a, 1);
+		return ;
+	}
+	r->neg = a->neg;
+}
+
+/*
+** r = a * b truncated to BIG_LIMBS limbs; r may alias either operand.
+** Each partial product plus the running limb and carry fits in 64 bits.
+*/
+void	big_mul(t_big *r, const t_big *a, const t_big *b)
+{
+	unsigned int		t[BIG_LIMBS];
+	unsigned long long	carry;
+	int					i;
+	int					j;
+
+	i = 0;
+	while (i < BIG_LIMBS)
+		t[i++] = 0;
+	i = -1;
+	while (++i < BIG_LIMBS)
+	{
+		carry = 0;
+		j = BIG_LIMBS - i;
+		while (j-- > 0)
+		{
+			carry += (unsigned long long)a->limb[i] * b->limb[j] + t[i + j];
+			t[i + j] = (unsigned int)carry;
+			carry >>= 32;
+		}
+		j = i;
+		while (carry && j-- > 0)
+		{
+			carry += t[j];
+			t[j] = (unsigned int)carry;
+			carry >>= 32;
+		}
+	}
+	r->neg = a->neg ^ b->neg;
+	i = -1;
+	while (++i < BIG_LIMBS)
+		r->limb[i] = t[i];
+}
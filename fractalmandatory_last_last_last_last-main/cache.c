@@ -0,0 +1,316 @@
+#include "fract.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+** Iteration options a tile's counts depend on.
+*/
+int	tile_flags(t_fractal *fract)
+{
+	return (fract->shortcuts | SMOOTH_COUNT * fract->smooth
+		| fract->subdivide << 3);
+}
+
+/*
+** Key of the lattice tile holding the screen rect (which never spans two
+** of them, see lattice_update()) and the rect's position inside it.
+*/
+static void	make_key(t_fractal *fract, int rect[4], t_tile_key *key,
+		int local[4])
+{
+	long	g[2];
+
+	g[0] = fract->lattice[0] + rect[0];
+	g[1] = fract->lattice[1] + rect[1];
+	key->spacing = fract->factors[0];
+	key->tx = (g[0] - ((g[0] % TILE_SIZE) + TILE_SIZE) % TILE_SIZE)
+		/ TILE_SIZE;
+	key->ty = (g[1] - ((g[1] % TILE_SIZE) + TILE_SIZE) % TILE_SIZE)
+		/ TILE_SIZE;
+	formula_params(fract, key->c);
+	key->type = fract->type;
+	key->max_iter = fract->max_iter;
+	key->flags = tile_flags(fract);
+	key->kernel = fract->iterate;
+	local[0] = g[0] - key->tx * TILE_SIZE;
+	local[1] = g[1] - key->ty * TILE_SIZE;
+	local[2] = local[0] + rect[2] - rect[0];
+	local[3] = local[1] + rect[3] - rect[1];
+}
+
+static t_cached	**bucket(t_cache *cache, const t_tile_key *k)
+{
+	unsigned long	h;
+
+	memcpy(&h, &k->spacing, sizeof(h));
+	h ^= (unsigned long)k->tx * 0x9E3779B97F4A7C15UL;
+	h ^= (unsigned long)k->ty * 0xC2B2AE3D27D4EB4FUL;
+	h ^= (unsigned long)k->max_iter;
+	return (cache->table + ((h ^ (h >> 29) ^ (h >> 47)) & cache->mask));
+}
+
+/*
+** Looks the key up and makes its entry the most recently used one.
+*/
+static t_cached	*find(t_cache *cache, const t_tile_key *k)
+{
+	t_cached	*e;
+
+	e = *bucket(cache, k);
+	while (e && (e->key.spacing != k->spacing || e->key.tx != k->tx
+			|| e->key.ty != k->ty || e->key.c[0] != k->c[0]
+			|| e->key.c[1] != k->c[1] || e->key.type != k->type
+			|| e->key.max_iter != k->max_iter || e->key.flags != k->flags
+			|| e->key.kernel != k->kernel))
+		e = e->chain;
+	if (!e || e == cache->head)
+		return (e);
+	e->prev->next = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		cache->tail = e->prev;
+	e->prev = NULL;
+	e->next = cache->head;
+	cache->head->prev = e;
+	cache->head = e;
+	return (e);
+}
+
+static void	load_tile(t_fractal *fract, const t_counts *t, int rect[4],
+		int local[4])
+{
+	size_t	len;
+	int		y;
+
+	len = (size_t)(rect[2] - rect[0]);
+	y = 0;
+	while (y < rect[3] - rect[1])
+	{
+		memcpy(fract->iters + (rect[1] + y) * fract->width + rect[0],
+			t->iter + (local[1] + y) * TILE_SIZE + local[0],
+			len * sizeof(int));
+		memcpy(fract->smooth_iters + (rect[1] + y) * fract->width + rect[0],
+			t->smooth + (local[1] + y) * TILE_SIZE + local[0],
+			len * sizeof(float));
+		y++;
+	}
+}
+
+static void	save_tile(t_fractal *fract, t_cached *e, int rect[4],
+		int local[4])
+{
+	size_t	len;
+	int		y;
+
+	len = (size_t)(rect[2] - rect[0]);
+	y = 0;
+	while (y < rect[3] - rect[1])
+	{
+		memcpy(e->counts.iter + (local[1] + y) * TILE_SIZE + local[0],
+			fract->iters + (rect[1] + y) * fract->width + rect[0],
+			len * sizeof(int));
+		memcpy(e->counts.smooth + (local[1] + y) * TILE_SIZE + local[0],
+			fract->smooth_iters + (rect[1] + y) * fract->width + rect[0],
+			len * sizeof(float));
+		y++;
+	}
+}
+
+/*
+** Fills the screen rect from the tile store or the cache, or only checks
+** that it could be when `copy` is 0. Returns 1 on a hit.
+*/
+static int	lookup(t_fractal *fract, int rect[4], int copy)
+{
+	t_tile_key		key;
+	const t_counts	*t;
+	t_cached		*e;
+	int				local[4];
+	int				hit;
+
+	if (!fract->cached)
+		return (0);
+	make_key(fract, rect, &key, local);
+	t = store_tile(fract, &key);
+	if (t && copy)
+		load_tile(fract, t, rect, local);
+	if (t || !fract->cache.table)
+		return (t != NULL);
+	pthread_mutex_lock(&fract->cache.lock);
+	e = find(&fract->cache, &key);
+	hit = e && e->rect[0] <= local[0] && e->rect[1] <= local[1]
+		&& e->rect[2] >= local[2] && e->rect[3] >= local[3];
+	if (hit && copy)
+		load_tile(fract, &e->counts, rect, local);
+	pthread_mutex_unlock(&fract->cache.lock);
+	return (hit);
+}
+
+/*
+** Counts as a hit or a miss only while the view sits on the lattice, when
+** looking tiles up is possible at all. Cached tiles have no orbits to
+** continue.
+*/
+int	cache_fetch(t_fractal *fract, int rect[4])
+{
+	int	hit;
+
+	hit = lookup(fract, rect, 1);
+	if (hit && fract->orbits)
+		forget_orbits(fract, rect);
+	if (hit)
+		stats_add(&fract->stats.cache_hits, 1);
+	else if (fract->cached)
+		stats_add(&fract->stats.cache_misses, 1);
+	return (hit);
+}
+
+int	cache_has(t_fractal *fract, int rect[4])
+{
+	return (lookup(fract, rect, 0));
+}
+
+/*
+** Drops the least recently used entry.
+*/
+static void	evict(t_cache *cache)
+{
+	t_cached	*e;
+	t_cached	**link;
+
+	e = cache->tail;
+	cache->tail = e->prev;
+	if (e->prev)
+		e->prev->next = NULL;
+	else
+		cache->head = NULL;
+	link = bucket(cache, &e->key);
+	while (*link != e)
+		link = &(*link)->chain;
+	*link = e->chain;
+	cache->used -= sizeof(t_cached);
+	free(e);
+}
+
+static t_cached	*insert(t_cache *cache, const t_tile_key *key)
+{
+	t_cached	*e;
+	t_cached	**link;
+
+	while (cache->head && cache->used + sizeof(t_cached) > cache->cap)
+		evict(cache);
+	if (cache->used + sizeof(t_cached) > cache->cap)
+		return (NULL);
+	e = malloc(sizeof(t_cached));
+	if (!e)
+		return (NULL);
+	e->key = *key;
+	link = bucket(cache, key);
+	e->chain = *link;
+	*link = e;
+	e->prev = NULL;
+	e->next = cache->head;
+	if (cache->head)
+		cache->head->prev = e;
+	else
+		cache->tail = e;
+	cache->head = e;
+	cache->used += sizeof(t_cached);
+	return (e);
+}
+
+/*
+** New counts for part of a tile replace the cached part when they cover
+** it, extend it when the two together form a rectangle, and otherwise
+** win if they are the larger part. Returns 0 when they are not kept.
+*/
+static int	merge_rect(int v[4], const int n[4])
+{
+	if ((v[0] == n[0] && v[2] == n[2] && n[1] <= v[3] && n[3] >= v[1])
+		|| (v[1] == n[1] && v[3] == n[3] && n[0] <= v[2] && n[2] >= v[0])
+		|| (n[0] <= v[0] && n[1] <= v[1] && n[2] >= v[2] && n[3] >= v[3]))
+	{
+		if (n[0] < v[0])
+			v[0] = n[0];
+		if (n[1] < v[1])
+			v[1] = n[1];
+		if (n[2] > v[2])
+			v[2] = n[2];
+		if (n[3] > v[3])
+			v[3] = n[3];
+		return (1);
+	}
+	if ((n[2] - n[0]) * (n[3] - n[1]) <= (v[2] - v[0]) * (v[3] - v[1]))
+		return (0);
+	v[0] = n[0];
+	v[1] = n[1];
+	v[2] = n[2];
+	v[3] = n[3];
+	return (1);
+}
+
+/*
+** Keeps the freshly computed counts of a screen rect, evicting the least
+** recently used tiles to stay under the memory cap.
+*/
+void	cache_store(t_fractal *fract, int rect[4])
+{
+	t_tile_key	key;
+	t_cached	*e;
+	int			local[4];
+
+	if (!fract->cached || !fract->cache.table)
+		return ;
+	make_key(fract, rect, &key, local);
+	pthread_mutex_lock(&fract->cache.lock);
+	e = find(&fract->cache, &key);
+	if (!e)
+	{
+		e = insert(&fract->cache, &key);
+		if (e)
+			memcpy(e->rect, local, sizeof(local));
+	}
+	if (e && merge_rect(e->rect, local))
+		save_tile(fract, e, rect, local);
+	pthread_mutex_unlock(&fract->cache.lock);
+}
+
+/*
+** cap is the memory limit in bytes; 0 leaves the cache off. The table is
+** sized for twice the number of tiles that fit.
+*/
+int	cache_init(t_cache *cache)
+{
+	size_t	buckets;
+
+	cache->table = NULL;
+	cache->head = NULL;
+	cache->tail = NULL;
+	cache->used = 0;
+	if (cache->cap < sizeof(t_cached))
+		return (0);
+	buckets = 1;
+	while (buckets < 2 * (cache->cap / sizeof(t_cached)))
+		buckets *= 2;
+	cache->table = calloc(buckets, sizeof(t_cached *));
+	if (!cache->table)
+	{
+		printf("Error: Cannot allocate the tile cache\n");
+		return (1);
+	}
+	cache->mask = buckets - 1;
+	pthread_mutex_init(&cache->lock, NULL);
+	return (0);
+}
+
+void	cache_free(t_cache *cache)
+{
+	if (!cache->table)
+		return ;
+	while (cache->head)
+		evict(cache);
+	free(cache->table);
+	cache->table = NULL;
+	pthread_mutex_destroy(&cache->lock);
+}
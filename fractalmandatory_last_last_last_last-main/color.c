@@ -0,0 +1,191 @@
+#include "fract.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*
+** One count buffer entry per pixel, row after row, plus the matching
+** smooth counts and anti-aliasing slots. They are the source of truth for
+** the picture: the image is only ever colored from them.
+*/
+int	alloc_iters(t_fractal *fract, int width, int height)
+{
+	int		*iters;
+	float	*smooth;
+	int		*slot;
+
+	iters = malloc((size_t)width * height * sizeof(int));
+	smooth = malloc((size_t)width * height * sizeof(float));
+	slot = malloc((size_t)width * height * sizeof(int));
+	if (!iters || !smooth || !slot)
+	{
+		printf("Error: Cannot allocate a %dx%d iteration buffer\n",
+			width, height);
+		free(iters);
+		free(smooth);
+		free(slot);
+		return (1);
+	}
+	free(fract->iters);
+	free(fract->smooth_iters);
+	free(fract->aa.slot);
+	fract->iters = iters;
+	fract->smooth_iters = smooth;
+	fract->aa.slot = slot;
+	fract->aa.valid = 0;
+	return (0);
+}
+
+/*
+** Branch free so the loop becomes vector gathers: interior counts read the
+** first entry and are masked to black afterwards.
+*/
+static void	color_span(const t_palette *p, const int *iter, int *dst, int n)
+{
+	const int	*lut;
+	int			size;
+	int			i;
+
+	i = 0;
+	if (!p->lut)
+	{
+		while (i < n)
+		{
+			dst[i] = get_color(p, iter[i]);
+			i++;
+		}
+		return ;
+	}
+	lut = p->lut + p->offset;
+	size = p->size;
+	while (i < n)
+	{
+		dst[i] = lut[iter[i] * (iter[i] < size)] & -(iter[i] < size);
+		i++;
+	}
+}
+
+/*
+** Smooth counts blend the two neighbouring table entries channel by
+** channel, again without branches.
+*/
+static void	smooth_span(const t_palette *p, const int *iter,
+		const float *smooth, int *dst, int n)
+{
+	const int	*lut;
+	float		f;
+	int			c[2];
+	int			i;
+
+	i = 0;
+	if (!p->lut)
+	{
+		while (i < n)
+		{
+			dst[i] = get_smooth_color(p, iter[i], smooth[i]);
+			i++;
+		}
+		return ;
+	}
+	lut = p->lut + p->offset;
+	while (i < n)
+	{
+		f = fminf(fmaxf(smooth[i], 0.0f), p->size - 1);
+		c[0] = lut[(int)f];
+		c[1] = lut[(int)f + 1];
+		f -= (int)f;
+		dst[i] = ((((c[0] >> 16) & 255) + (int)(f * (((c[1] >> 16) & 255)
+							- ((c[0] >> 16) & 255)))) << 16
+				| (((c[0] >> 8) & 255) + (int)(f * (((c[1] >> 8) & 255)
+							- ((c[0] >> 8) & 255)))) << 8
+				| ((c[0] & 255) + (int)(f * ((c[1] & 255) - (c[0] & 255)))))
+			& -(iter[i] < p->size);
+		i++;
+	}
+}
+
+/*
+** Mean of the colors of a supersampled pixel's samples.
+*/
+static int	mean_color(t_fractal *fract, int slot)
+{
+	int	sum[3];
+	int	c;
+	int	k;
+
+	sum[0] = 0;
+	sum[1] = 0;
+	sum[2] = 0;
+	k = slot * AA_SAMPLES;
+	while (k < (slot + 1) * AA_SAMPLES)
+	{
+		if (fract->smooth)
+			c = get_smooth_color(&fract->colors, fract->aa.iter[k],
+					fract->aa.smooth[k]);
+		else
+			c = get_color(&fract->colors, fract->aa.iter[k]);
+		sum[0] += (c >> 16) & 255;
+		sum[1] += (c >> 8) & 255;
+		sum[2] += c & 255;
+		k++;
+	}
+	return ((sum[0] / AA_SAMPLES) << 16 | (sum[1] / AA_SAMPLES) << 8
+		| sum[2] / AA_SAMPLES);
+}
+
+static void	color_pixels(t_fractal *fract, int y, int x0, int x1)
+{
+	int	*slot;
+	int	*dst;
+	int	i;
+
+	dst = (int *)(fract->addr + y * fract->line_len) + x0;
+	i = y * fract->width + x0;
+	if (fract->smooth)
+		smooth_span(&fract->colors, fract->iters + i, fract->smooth_iters + i,
+			dst, x1 - x0);
+	else
+		color_span(&fract->colors, fract->iters + i, dst, x1 - x0);
+	slot = fract->aa.slot + i;
+	while (fract->aa.valid && x0 < x1)
+	{
+		if (*slot >= 0)
+			*dst = mean_color(fract, *slot);
+		slot++;
+		dst++;
+		x0++;
+	}
+}
+
+/*
+** Colors the pixels of rect = {x0, y0, x1, y1} from the count buffers.
+*/
+void	color_rect(t_fractal *fract, int rect[4])
+{
+	long	start;
+	int		y;
+
+	start = stats_now();
+	y = rect[1];
+	while (y < rect[3])
+		color_pixels(fract, y++, rect[0], rect[2]);
+	stats_add(&fract->stats.color, stats_now() - start);
+}
+
+static void	color_row(t_fractal *fract, int y)
+{
+	long	start;
+
+	start = stats_now();
+	color_pixels(fract, y, 0, fract->width);
+	stats_add(&fract->stats.color, stats_now() - start);
+}
+
+/*
+** Palette and color shift changes only repaint the image from the count
+** buffer; nothing is iterated again. The window publishes the result.
+*/
+void	recolor(t_fractal *fract)
+{
+	palette_update(fract);
+	pool_run(fract, color_row, fract->height);
+}
@@ -0,0 +1,241 @@
+#include "fract.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*
+** Adds (re, im) to the origin and subtracts it from every view coordinate,
+** the saved frame's included, so the picture does not move.
+*/
+static void	move_origin(t_fractal *fract, double re, double im)
+{
+	t_big	d;
+
+	big_from_double(&d, re);
+	big_add(&fract->deep.origin[0], &fract->deep.origin[0], &d);
+	big_from_double(&d, im);
+	big_add(&fract->deep.origin[1], &fract->deep.origin[1], &d);
+	fract->min_re -= re;
+	fract->max_re -= re;
+	fract->min_im -= im;
+	fract->max_im -= im;
+	fract->prev_view[0] -= re;
+	fract->prev_view[1] -= im;
+	fract->deep.based = 1;
+	fract->deep.valid = 0;
+}
+
+/*
+** Frames the view around the --center text at full precision: the origin
+** holds the exact decimal and the double view is centered on 0, so spans
+** far below the resolution of a double around the center stay usable.
+*/
+void	deep_origin(t_fractal *fract, const char *text[2], double span)
+{
+	set_view(fract, 0.0, 0.0, span);
+	big_from_str(&fract->deep.origin[0], text[0]);
+	big_from_str(&fract->deep.origin[1], text[1]);
+	fract->deep.based = 1;
+	fract->deep.valid = 0;
+}
+
+/*
+** Stores Z_0 .. Z_n rounded to doubles, stopping after the first escaped
+** point or at max_iter.
+*/
+static void	compute_orbit(t_orbit *o, t_big z[2], const t_big c[2],
+		int max_iter)
+{
+	t_big	sq[3];
+
+	o->len = 0;
+	while (1)
+	{
+		o->zr[o->len] = big_to_double(&z[0]);
+		o->zi[o->len] = big_to_double(&z[1]);
+		o->len++;
+		if (o->len > max_iter || o->zr[o->len - 1] * o->zr[o->len - 1]
+			+ o->zi[o->len - 1] * o->zi[o->len - 1] > 4.0)
+			return ;
+		big_mul(&sq[0], &z[0], &z[0]);
+		big_mul(&sq[1], &z[1], &z[1]);
+		big_mul(&sq[2], &z[0], &z[1]);
+		sq[1].neg = !sq[1].neg;
+		big_add(&z[0], &sq[0], &sq[1]);
+		big_add(&z[0], &z[0], &c[0]);
+		big_add(&z[1], &sq[2], &sq[2]);
+		big_add(&z[1], &z[1], &c[1]);
+	}
+}
+
+/*
+** orbit[0] starts at the origin (Julia) or iterates c = origin (Mandelbrot).
+** Julia also needs the orbit of the critical point 0, which rebasing falls
+** back to; for Mandelbrot that is orbit[0] itself.
+*/
+static void	reference_orbits(t_fractal *fract, t_deep *d)
+{
+	t_big	z[2];
+	t_big	c[2];
+
+	d->julia = fract->type != MANDELBROT;
+	big_from_double(&c[0], fract->c_re);
+	big_from_double(&c[1], fract->c_im);
+	z[0] = d->origin[0];
+	z[1] = d->origin[1];
+	if (!d->julia)
+	{
+		c[0] = d->origin[0];
+		c[1] = d->origin[1];
+		big_from_double(&z[0], 0.0);
+		big_from_double(&z[1], 0.0);
+	}
+	compute_orbit(&d->orbit[0], z, c, fract->max_iter);
+	big_from_double(&z[0], 0.0);
+	big_from_double(&z[1], 0.0);
+	if (d->julia)
+		compute_orbit(&d->orbit[1], z, c, fract->max_iter);
+	d->key_iter = fract->max_iter;
+	d->key_c[0] = fract->c_re;
+	d->key_c[1] = fract->c_im;
+	d->valid = 1;
+}
+
+/*
+** Cubic series for the deviation after n reference steps, with every
+** coefficient pre-scaled by the view radius r:
+** dz_n = a u + b u^2 + c u^3 for u = delta / r. Each step is
+** a' = 2Z a (+ r for Mandelbrot), b' = 2Z b + a^2, c' = 2Z c + 2ab, and
+** skipping stops once the cubic term is no longer negligible.
+*/
+static void	update_series(t_deep *d, int max_iter)
+{
+	const t_orbit	*o;
+	double			*s;
+	double			t[6];
+
+	o = &d->orbit[0];
+	s = d->series;
+	s[0] = d->radius * d->julia;
+	s[1] = 0.0;
+	s[2] = 0.0;
+	s[3] = 0.0;
+	s[4] = 0.0;
+	s[5] = 0.0;
+	d->skip = 0;
+	while (d->skip + 2 < o->len && d->skip < max_iter)
+	{
+		t[0] = 2.0 * (o->zr[d->skip] * s[0] - o->zi[d->skip] * s[1]);
+		t[1] = 2.0 * (o->zr[d->skip] * s[1] + o->zi[d->skip] * s[0]);
+		t[2] = 2.0 * (o->zr[d->skip] * s[2] - o->zi[d->skip] * s[3])
+			+ s[0] * s[0] - s[1] * s[1];
+		t[3] = 2.0 * (o->zr[d->skip] * s[3] + o->zi[d->skip] * s[2]
+				+ s[0] * s[1]);
+		t[4] = 2.0 * (o->zr[d->skip] * s[4] - o->zi[d->skip] * s[5]
+				+ s[0] * s[2] - s[1] * s[3]);
+		t[5] = 2.0 * (o->zr[d->skip] * s[5] + o->zi[d->skip] * s[4]
+				+ s[0] * s[3] + s[1] * s[2]);
+		t[0] += d->radius * !d->julia;
+		if (hypot(t[4], t[5]) > SERIES_EPS * hypot(t[0], t[1]))
+			return ;
+		s[0] = t[0];
+		s[1] = t[1];
+		s[2] = t[2];
+		s[3] = t[3];
+		s[4] = t[4];
+		s[5] = t[5];
+		d->skip++;
+	}
+}
+
+static int	deep_alloc(t_fractal *fract)
+{
+	t_deep	*d;
+	size_t	size;
+
+	d = &fract->deep;
+	deep_free(fract);
+	size = (fract->max_iter + 1) * sizeof(double);
+	d->orbit[0].zr = malloc(size);
+	d->orbit[0].zi = malloc(size);
+	d->orbit[1].zr = malloc(size);
+	d->orbit[1].zi = malloc(size);
+	if (!d->orbit[0].zr || !d->orbit[0].zi || !d->orbit[1].zr
+		|| !d->orbit[1].zi)
+	{
+		printf("Error: Cannot allocate the deep zoom reference orbit\n");
+		deep_free(fract);
+		return (1);
+	}
+	d->capacity = fract->max_iter + 1;
+	return (0);
+}
+
+/*
+** Called before every pass. Above DEEP_SPACING any origin is folded back
+** into plain doubles. Below it the origin follows the view center, the
+** reference orbits are recomputed whenever the origin, max_iter or the
+** Julia constant change, and the series whenever the radius does. Only
+** formulas with FORMULA_DEEP have a perturbation kernel. When the orbits
+** cannot be allocated the view is folded back as well, before anything
+** is rebased, and rendered with plain doubles where it is.
+*/
+void	deep_update(t_fractal *fract)
+{
+	t_deep	*d;
+	double	c[2];
+	double	spacing;
+	double	radius;
+
+	d = &fract->deep;
+	c[0] = (fract->min_re + fract->max_re) / 2.0;
+	c[1] = (fract->min_im + fract->max_im) / 2.0;
+	spacing = (fract->max_re - fract->min_re) / (fract->width - 1);
+	d->active = spacing < DEEP_SPACING
+		&& (fract->formula->flags & FORMULA_DEEP);
+	if (d->active && d->capacity <= fract->max_iter)
+		d->active = !deep_alloc(fract);
+	if (!d->active && d->based)
+	{
+		c[0] = -big_to_double(&d->origin[0]);
+		c[1] = -big_to_double(&d->origin[1]);
+		move_origin(fract, c[0], c[1]);
+		big_from_double(&d->origin[0], 0.0);
+		big_from_double(&d->origin[1], 0.0);
+		d->based = 0;
+	}
+	if (!d->active)
+		return ;
+	if (fabs(c[0]) > spacing / 2.0 || fabs(c[1]) > spacing / 2.0)
+		move_origin(fract, c[0], c[1]);
+	if (!d->valid || d->key_iter != fract->max_iter
+		|| d->julia != (fract->type != MANDELBROT)
+		|| d->key_c[0] != fract->c_re || d->key_c[1] != fract->c_im)
+	{
+		reference_orbits(fract, d);
+		d->radius = -1.0;
+	}
+	radius = hypot(fmax(-fract->min_re, fract->max_re),
+			fmax(-fract->min_im, fract->max_im));
+	if (radius != d->radius)
+	{
+		d->radius = radius;
+		update_series(d, fract->max_iter);
+	}
+}
+
+void	deep_free(t_fractal *fract)
+{
+	t_deep	*d;
+
+	d = &fract->deep;
+	free(d->orbit[0].zr);
+	free(d->orbit[0].zi);
+	free(d->orbit[1].zr);
+	free(d->orbit[1].zi);
+	d->orbit[0].zr = NULL;
+	d->orbit[0].zi = NULL;
+	d->orbit[1].zr = NULL;
+	d->orbit[1].zi = NULL;
+	d->capacity = 0;
+	d->valid = 0;
+}
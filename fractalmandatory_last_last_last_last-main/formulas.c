@@ -0,0 +1,404 @@
+#include "fract.h"
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+#endif
+
+/*
+** The escape-time formulas besides z^2 + c, each written once as a step
+** from z to w and a test for orbits still going. The same text serves
+** scalars and GCC vectors of every element type: ABS is the element
+** type's absolute value and comparisons are combined with &, which both
+** understand. w[2] is scratch.
+*/
+#define BURNING_SHIP_STEP(w, z, c, ABS, N) \
+	w[0] = z[0] * z[0] - z[1] * z[1] + c[0]; \
+	w[1] = 2 * ABS(z[0] * z[1]) + c[1];
+
+#define TRICORN_STEP(w, z, c, ABS, N) \
+	w[0] = z[0] * z[0] - z[1] * z[1] + c[0]; \
+	w[1] = -2 * z[0] * z[1] + c[1];
+
+#define MULTIBROT_STEP(w, z, c, ABS, N) \
+	{ \
+		int	n; \
+ \
+		w[0] = z[0]; \
+		w[1] = z[1]; \
+		n = 1; \
+		while (n++ < N) \
+		{ \
+			w[2] = w[0] * z[0] - w[1] * z[1]; \
+			w[1] = w[0] * z[1] + w[1] * z[0]; \
+			w[0] = w[2]; \
+		} \
+		w[0] += c[0]; \
+		w[1] += c[1]; \
+	}
+
+#define ESCAPE_LIVE(z, bail, REAL) (z[0] * z[0] + z[1] * z[1] <= (REAL)(bail))
+
+/*
+** Newton's method for z^3 - 1: z - (z^3 - 1) / 3z^2 = 2z / 3 + 1 / 3z^2.
+** The count is the number of steps until z is within NEWTON_EPS of one
+** of the three roots.
+*/
+#define NEWTON_STEP(w, z, c, ABS, N) \
+	w[2] = z[0] * z[0] + z[1] * z[1]; \
+	w[2] = 3 * w[2] * w[2]; \
+	w[0] = 2 * z[0] / 3 + (z[0] * z[0] - z[1] * z[1]) / w[2]; \
+	w[1] = 2 * z[1] / 3 - 2 * z[0] * z[1] / w[2];
+
+#define NEWTON_LIVE(z, bail, REAL) \
+	(((z[0] - 1) * (z[0] - 1) + z[1] * z[1] > (REAL)NEWTON_EPS) \
+	& ((z[0] + (REAL)0.5) * (z[0] + (REAL)0.5) + (z[1] - (REAL)NEWTON_IM) \
+		* (z[1] - (REAL)NEWTON_IM) > (REAL)NEWTON_EPS) \
+	& ((z[0] + (REAL)0.5) * (z[0] + (REAL)0.5) + (z[1] + (REAL)NEWTON_IM) \
+		* (z[1] + (REAL)NEWTON_IM) > (REAL)NEWTON_EPS))
+
+/*
+** Same shape as SCALAR_KERNEL in kernels_float.c, without the bulbs,
+** which are a property of the Mandelbrot set alone. z[2..3] is the point
+** saved for cycle detection, z[4..5] is c.
+*/
+#define SCALAR_FORMULA(NAME, REAL, EPS, ABS, STEP, LIVE) \
+static void	NAME(t_batch *b) \
+{ \
+	REAL	z[6]; \
+	REAL	w[3]; \
+	int		check; \
+	int		i; \
+ \
+	i = -1; \
+	while (++i < b->n) \
+	{ \
+		z[0] = b->zr[i]; \
+		z[1] = b->zi[i]; \
+		z[2] = z[0]; \
+		z[3] = z[1]; \
+		z[4] = b->cr[i]; \
+		z[5] = b->ci[i]; \
+		b->iter[i] = 0; \
+		check = PERIOD_FIRST; \
+		while (LIVE(z, 4, REAL) && b->iter[i] < b->max_iter) \
+		{ \
+			STEP(w, z, (z + 4), ABS, b->power) \
+			z[0] = w[0]; \
+			z[1] = w[1]; \
+			b->iter[i]++; \
+			if ((b->flags & SHORTCUT_PERIOD) && z[0] - z[2] < EPS \
+				&& z[2] - z[0] < EPS && z[1] - z[3] < EPS \
+				&& z[3] - z[1] < EPS) \
+				b->iter[i] = b->max_iter; \
+			else if ((b->flags & SHORTCUT_PERIOD) && b->iter[i] == check) \
+			{ \
+				z[2] = z[0]; \
+				z[3] = z[1]; \
+				check *= 2; \
+			} \
+		} \
+		b->steps[i] = b->iter[i]; \
+		while ((b->flags & SMOOTH_COUNT) && b->iter[i] < b->max_iter \
+			&& b->steps[i] < b->max_iter && LIVE(z, SMOOTH_BAILOUT, REAL)) \
+		{ \
+			STEP(w, z, (z + 4), ABS, b->power) \
+			z[0] = w[0]; \
+			z[1] = w[1]; \
+			b->steps[i]++; \
+		} \
+		b->zr[i] = z[0]; \
+		b->zi[i] = z[1]; \
+	} \
+}
+
+/*
+** Same shape as VECTOR_KERNEL in kernels_float.c, for any element type:
+** INT is the integer type of the same width, MASK clears its sign bit.
+** Lanes past b->n start inactive.
+*/
+#define VECTOR_FORMULA(NAME, REAL, INT, MASK, EPS, LANES, TARGET, ANY, F) \
+typedef REAL	t_##NAME##_f __attribute__((vector_size(sizeof(REAL) \
+	* LANES))); \
+typedef INT		t_##NAME##_i __attribute__((vector_size(sizeof(REAL) \
+	* LANES))); \
+ \
+__attribute__((target(TARGET), unused)) \
+static inline t_##NAME##_f	NAME##_abs(t_##NAME##_f v) \
+{ \
+	return ((t_##NAME##_f)((t_##NAME##_i)v & MASK)); \
+} \
+ \
+__attribute__((target(TARGET))) \
+static t_##NAME##_i	NAME##_load(t_batch *b, int i, t_##NAME##_f z[6], \
+		t_##NAME##_i *count) \
+{ \
+	t_##NAME##_i	active; \
+	int				k; \
+ \
+	z[0] = (t_##NAME##_f){0}; \
+	z[1] = z[0]; \
+	z[4] = z[0]; \
+	z[5] = z[0]; \
+	*count = (t_##NAME##_i){0}; \
+	active = *count; \
+	k = -1; \
+	while (++k < LANES && i + k < b->n) \
+	{ \
+		z[0][k] = b->zr[i + k]; \
+		z[1][k] = b->zi[i + k]; \
+		z[4][k] = b->cr[i + k]; \
+		z[5][k] = b->ci[i + k]; \
+		active[k] = -1; \
+	} \
+	z[2] = z[0]; \
+	z[3] = z[1]; \
+	return (active); \
+} \
+ \
+__attribute__((target(TARGET), always_inline)) \
+static inline void	NAME##_group(t_batch *b, int i, int smooth) \
+{ \
+	t_##NAME##_f	z[6]; \
+	t_##NAME##_f	w[3]; \
+	t_##NAME##_i	m[3]; \
+	t_##NAME##_i	count[2]; \
+	int				k[2]; \
+ \
+	m[0] = NAME##_load(b, i, z, count); \
+	m[1] = m[0]; \
+	count[1] = count[0]; \
+	k[0] = 0; \
+	k[1] = PERIOD_FIRST; \
+	while (k[0] < b->max_iter) \
+	{ \
+		m[0] &= F##_LIVE(z, 4, REAL); \
+		m[1] &= F##_LIVE(z, SMOOTH_BAILOUT, REAL); \
+		if (!smooth) \
+			m[1] = m[0]; \
+		if (!ANY(m[1])) \
+			break ; \
+		F##_STEP(w, z, (z + 4), NAME##_abs, b->power) \
+		z[0] = (t_##NAME##_f)(((t_##NAME##_i)w[0] & m[1]) \
+				| ((t_##NAME##_i)z[0] & ~m[1])); \
+		z[1] = (t_##NAME##_f)(((t_##NAME##_i)w[1] & m[1]) \
+				| ((t_##NAME##_i)z[1] & ~m[1])); \
+		count[0] -= m[0]; \
+		if (smooth) \
+			count[1] -= m[1]; \
+		k[0]++; \
+		if (b->flags & SHORTCUT_PERIOD) \
+		{ \
+			m[2] = m[0] & (z[0] - z[2] < EPS) \
+				& (z[2] - z[0] < EPS) \
+				& (z[1] - z[3] < EPS) \
+				& (z[3] - z[1] < EPS); \
+			count[0] = (count[0] & ~m[2]) | (b->max_iter & m[2]); \
+			m[0] &= ~m[2]; \
+			m[1] &= ~m[2]; \
+			if (k[0] == k[1]) \
+			{ \
+				z[2] = z[0]; \
+				z[3] = z[1]; \
+				k[1] *= 2; \
+			} \
+		} \
+	} \
+	k[0] = -1; \
+	while (++k[0] < LANES && i + k[0] < b->n) \
+	{ \
+		b->iter[i + k[0]] = count[0][k[0]]; \
+		b->steps[i + k[0]] = count[1][k[0]]; \
+		b->zr[i + k[0]] = z[0][k[0]]; \
+		b->zi[i + k[0]] = z[1][k[0]]; \
+	} \
+} \
+ \
+__attribute__((target(TARGET))) \
+static void	NAME(t_batch *b) \
+{ \
+	int	i; \
+ \
+	i = 0; \
+	while (i < b->n && (b->flags & SMOOTH_COUNT)) \
+	{ \
+		NAME##_group(b, i, 1); \
+		i += LANES; \
+	} \
+	while (i < b->n) \
+	{ \
+		NAME##_group(b, i, 0); \
+		i += LANES; \
+	} \
+}
+
+/*
+** Every kernel of formula F: the three scalar element types and, on x86,
+** float and double vectors of each width.
+*/
+#define SCALAR_FORMULAS(NAME, F) \
+SCALAR_FORMULA(NAME##_f32, float, PERIOD_EPS_F, fabsf, F##_STEP, F##_LIVE) \
+SCALAR_FORMULA(NAME##_f64, double, PERIOD_EPS, fabs, F##_STEP, F##_LIVE) \
+SCALAR_FORMULA(NAME##_f80, long double, PERIOD_EPS_L, fabsl, F##_STEP, \
+	F##_LIVE)
+
+#define VECTOR_FORMULAS(NAME, F) \
+VECTOR_FORMULA(NAME##_sse2_f32, float, int, 0x7FFFFFFF, PERIOD_EPS_F, 4, \
+	"sse2", SSE2_ANY_F32, F) \
+VECTOR_FORMULA(NAME##_avx2_f32, float, int, 0x7FFFFFFF, PERIOD_EPS_F, 8, \
+	"avx2", AVX2_ANY_F32, F) \
+VECTOR_FORMULA(NAME##_avx512_f32, float, int, 0x7FFFFFFF, PERIOD_EPS_F, 16, \
+	"avx512f", AVX512_ANY_F32, F) \
+VECTOR_FORMULA(NAME##_sse2_f64, double, long, 0x7FFFFFFFFFFFFFFFL, \
+	PERIOD_EPS, 2, "sse2", SSE2_ANY_F64, F) \
+VECTOR_FORMULA(NAME##_avx2_f64, double, long, 0x7FFFFFFFFFFFFFFFL, \
+	PERIOD_EPS, 4, "avx2", AVX2_ANY_F64, F) \
+VECTOR_FORMULA(NAME##_avx512_f64, double, long, 0x7FFFFFFFFFFFFFFFL, \
+	PERIOD_EPS, 8, "avx512f", AVX512_ANY_F64, F)
+
+#define BURNING_SHIP_LIVE ESCAPE_LIVE
+#define TRICORN_LIVE ESCAPE_LIVE
+#define MULTIBROT_LIVE ESCAPE_LIVE
+
+SCALAR_FORMULAS(iterate_burning_ship, BURNING_SHIP)
+SCALAR_FORMULAS(iterate_tricorn, TRICORN)
+SCALAR_FORMULAS(iterate_multibrot, MULTIBROT)
+SCALAR_FORMULAS(iterate_newton, NEWTON)
+
+#if defined(__x86_64__) || defined(__i386__)
+
+# define SSE2_ANY_F32(m) _mm_movemask_ps((__m128)(m))
+# define AVX2_ANY_F32(m) _mm256_movemask_ps((__m256)(m))
+# define AVX512_ANY_F32(m) _mm512_test_epi32_mask((__m512i)(m), (__m512i)(m))
+# define SSE2_ANY_F64(m) _mm_movemask_pd((__m128d)(m))
+# define AVX2_ANY_F64(m) _mm256_movemask_pd((__m256d)(m))
+# define AVX512_ANY_F64(m) _mm512_test_epi64_mask((__m512i)(m), (__m512i)(m))
+
+VECTOR_FORMULAS(iterate_burning_ship, BURNING_SHIP)
+VECTOR_FORMULAS(iterate_tricorn, TRICORN)
+VECTOR_FORMULAS(iterate_multibrot, MULTIBROT)
+VECTOR_FORMULAS(iterate_newton, NEWTON)
+
+# define KERNELS(SCALAR, SSE2, AVX2, AVX512) {SCALAR, SSE2, AVX2, AVX512}
+#else
+# define KERNELS(SCALAR, SSE2, AVX2, AVX512) {SCALAR, SCALAR, SCALAR, SCALAR}
+#endif
+
+#define FORMULA_KERNELS(NAME) { \
+	KERNELS(NAME##_f32, NAME##_sse2_f32, NAME##_avx2_f32, NAME##_avx512_f32), \
+	KERNELS(NAME##_f64, NAME##_sse2_f64, NAME##_avx2_f64, NAME##_avx512_f64), \
+	KERNELS(NAME##_f80, NAME##_f80, NAME##_f80, NAME##_f80)}
+
+static void	load_mandelbrot(t_fractal *fract, t_batch *b, int i, double c[2])
+{
+	(void)fract;
+	b->zr[i] = 0.0;
+	b->zi[i] = 0.0;
+	b->cr[i] = c[0];
+	b->ci[i] = c[1];
+}
+
+static void	load_julia(t_fractal *fract, t_batch *b, int i, double c[2])
+{
+	b->zr[i] = c[0];
+	b->zi[i] = c[1];
+	b->cr[i] = fract->c_re;
+	b->ci[i] = fract->c_im;
+}
+
+/*
+** Indexed by t_fractal_type. params is the number of arguments after the
+** name, power the degree (0 for the one --power sets), flags the batch
+** flags that apply, plus FORMULA_DEEP when perturbation can take over
+** deep views and FORMULA_SUBDIVIDE when the set is connected.
+*/
+static const t_formula	g_formulas[NUM_FORMULAS] = {
+{"mandelbrot", MANDELBROT, 0, 2,
+	SHORTCUT_BULBS | SHORTCUT_PERIOD | SMOOTH_COUNT | FORMULA_DEEP
+	| FORMULA_SUBDIVIDE,
+	load_mandelbrot, {
+	KERNELS(iterate_float, iterate_sse2_f32, iterate_avx2_f32,
+		iterate_avx512_f32),
+	KERNELS(iterate_scalar, iterate_sse2, iterate_avx2, iterate_avx512),
+	KERNELS(iterate_long, iterate_long, iterate_long, iterate_long)}},
+{"julia", JULIA, 2, 2,
+	SHORTCUT_PERIOD | SMOOTH_COUNT | FORMULA_DEEP | FORMULA_SUBDIVIDE,
+	load_julia, {
+	KERNELS(iterate_float, iterate_sse2_f32, iterate_avx2_f32,
+		iterate_avx512_f32),
+	KERNELS(iterate_scalar, iterate_sse2, iterate_avx2, iterate_avx512),
+	KERNELS(iterate_long, iterate_long, iterate_long, iterate_long)}},
+{"burning_ship", BURNING_SHIP, 0, 2, SHORTCUT_PERIOD | SMOOTH_COUNT,
+	load_mandelbrot, FORMULA_KERNELS(iterate_burning_ship)},
+{"tricorn", TRICORN, 0, 2, SHORTCUT_PERIOD | SMOOTH_COUNT,
+	load_mandelbrot, FORMULA_KERNELS(iterate_tricorn)},
+{"multibrot", MULTIBROT, 0, 0,
+	SHORTCUT_PERIOD | SMOOTH_COUNT | FORMULA_SUBDIVIDE,
+	load_mandelbrot, FORMULA_KERNELS(iterate_multibrot)},
+{"newton", NEWTON, 0, 3, 0, load_julia, FORMULA_KERNELS(iterate_newton)}};
+
+const t_formula	*find_formula(const char *name)
+{
+	int	i;
+
+	i = 0;
+	while (i < NUM_FORMULAS && ft_strcmp(name, g_formulas[i].name) != 0)
+		i++;
+	if (i == NUM_FORMULAS)
+		return (NULL);
+	return (g_formulas + i);
+}
+
+/*
+** 0 for scalar code, then 1 to 3 for SSE2, AVX2 and AVX-512.
+*/
+static int	simd_level(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return (3);
+	if (__builtin_cpu_supports("avx2"))
+		return (2);
+	if (__builtin_cpu_supports("sse2"))
+		return (1);
+#endif
+	return (0);
+}
+
+/*
+** Everything that depends on the formula is picked here, once: the
+** kernel of each precision for this CPU and the way pixels are loaded.
+** Nothing inside the pixel loops looks at the type again.
+*/
+void	set_formula(t_fractal *fract, t_fractal_type type)
+{
+	const t_formula	*f;
+	int				level;
+	int				i;
+
+	f = g_formulas + type;
+	level = simd_level();
+	fract->formula = f;
+	fract->type = type;
+	i = -1;
+	while (++i < 3)
+		fract->kernels[i] = f->kernels[i][level];
+	fract->iterate = fract->kernels[PREC_DOUBLE];
+}
+
+/*
+** The parameters tile keys depend on besides the type: the constant of
+** the formulas that take one, the degree of Multibrot.
+*/
+void	formula_params(t_fractal *fract, double c[2])
+{
+	c[0] = 0.0;
+	c[1] = 0.0;
+	if (fract->formula->params)
+	{
+		c[0] = fract->c_re;
+		c[1] = fract->c_im;
+	}
+	if (fract->type == MULTIBROT)
+		c[0] = fract->power;
+}
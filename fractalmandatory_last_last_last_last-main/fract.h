@@ -1,18 +1,523 @@
 #ifndef FRACT_H
 #define FRACT_H
 
+#include <pthread.h>
+#include <stdio.h>
+
 #define WIDTH 1024
 #define HEIGHT 768
 #define MAX_ITER 100
+#define MAX_THREADS 64
+#define TILE_SIZE 32
+#define BATCH_SIZE 32
+#define PREVIEW_STEP 8
+#define IDLE_SLEEP_US 2000
+#define MAX_SIZE 65535
+#define MAX_PIXELS 134217727
+#define IDAT_SIZE 65536
+#define PAN_DIVISOR 10
+#define SHORTCUT_BULBS 1
+#define SHORTCUT_PERIOD 2
+#define SMOOTH_COUNT 4
+#define RESUME_ORBIT 8
+#define FORMULA_DEEP 16
+#define FORMULA_SUBDIVIDE 32
+#define NUM_FORMULAS 6
+#define MULTIBROT_POWER 3
+#define MAX_POWER 16
+#define NEWTON_EPS 1e-6
+#define NEWTON_IM 0.86602540378443864676
+#define SMOOTH_BAILOUT 65536.0
+#define PERIOD_FIRST 16
+#define PERIOD_EPS 1e-13
+#define PERIOD_EPS_F 1e-6f
+#define PERIOD_EPS_L 1e-17L
+#define FLOAT_SPACING 1e-5
+#define SUBDIVIDE_MIN 4
+#define BIG_LIMBS 16
+#define DEEP_SPACING 1e-12
+#define MIN_SPACING 1e-130
+#define SERIES_EPS 1e-12
+#define NUM_PALETTES 6
+#define PALETTE_LUT_MAX 1048576
+#define CYCLE_STEP 0.004
+#define AA_SAMPLES 16
+#define AA_THRESHOLD 1
+#define CACHE_MB 256
+#define LATTICE_MAX 1099511627776.0
+#define STORE_MAGIC "FRACTPYR"
+#define STORE_VERSION 1
+#define STORE_LEVELS 64
+#define STORE_CHUNK 16
+#define SERVE_PORT 8080
+#define SERVE_TILE 256
+#define SERVE_MAX_ZOOM 30
+#define SERVE_QUEUE 64
+#define SERVE_WAITERS 16
+#define SERVE_WORKERS 2
+#define SERVE_HEAD 2048
+#define SERVE_TIMEOUT 2
+#define SERVE_PENDING 64
+#define SERVE_POLL_MS 250
+#define REQ_FREE 0
+#define REQ_QUEUED 1
+#define REQ_RENDERING 2
+#define BENCH_SIZE "800x600"
+#define BENCH_FRAMES 10
+#define VERIFY_SIZE "256x192"
+#define VERIFY_SMOOTH_EPS 1e-3
+#ifndef VERIFY_GOLDEN
+# define VERIFY_GOLDEN "golden"
+#endif
+#define VERIFY_GOLDEN_SIZE "64x64"
+#define VIEW_SCALAR 1
+#define VIEW_GOLDEN 2
+#define STATS_PERIOD_MS 1000
+#define HUD_COLOR 0xFFFFFF
+#define AUTO_SPAN 4.0
+#define AUTO_ITER_MIN 100
+#define AUTO_ITER_OCTAVE 50
+#define AUTO_ITER_MAX 1000000
+#define AUTO_TAIL 0.005
+#define AUTO_SCALE_MIN 0.25
 #define ESC_KEY 65307
+#define SPACE_KEY 32
+#define W_KEY 119
+#define A_KEY 97
+#define S_KEY 115
+#define D_KEY 100
+#define C_KEY 99
+#define E_KEY 101
+#define G_KEY 103
+#define M_KEY 109
+#define X_KEY 120
+#define I_KEY 105
+#define UP_KEY 65362
+#define DOWN_KEY 65364
+#define LEFT_KEY 65361
+#define RIGHT_KEY 65363
+#define PLUS_KEY 61
+#define KP_PLUS_KEY 65451
+#define MINUS_KEY 45
+#define KP_MINUS_KEY 65453
+
+typedef enum e_precision
+{
+	PREC_FLOAT,
+	PREC_DOUBLE,
+	PREC_LONG,
+	PREC_AUTO
+}	t_precision;
 
 typedef enum e_fractal_type
 {
 	MANDELBROT,
-	JULIA
+	JULIA,
+	BURNING_SHIP,
+	TRICORN,
+	MULTIBROT,
+	NEWTON
 }	t_fractal_type;
 
-typedef struct s_fractal
+typedef enum e_color_palette
+{
+	PALETTE_DEFAULT,
+	PALETTE_FIRE,
+	PALETTE_OCEAN,
+	PALETTE_PSYCHEDELIC,
+	PALETTE_GRAYSCALE,
+	PALETTE_RAINBOW
+}	t_color_palette;
+
+/*
+** Palette baked for one max_iter: lut holds two copies of the size
+** colors and offset (0 .. size - 1) is the current cycle shift.
+*/
+typedef struct s_palette
+{
+	int				*lut;
+	int				size;
+	int				offset;
+	t_color_palette	type;
+}	t_palette;
+
+/*
+** Adaptive anti-aliasing. slot holds, per pixel, the store index of its
+** AA_SAMPLES supersamples in iter/smooth, or -1 for a pixel shown with its
+** single sample. Pixels from first on were stored by the latest pass.
+*/
+typedef struct s_aa
+{
+	int		*slot;
+	int		*iter;
+	float	*smooth;
+	int		count;
+	int		capacity;
+	int		first;
+	int		rect[4];
+	int		on;
+	int		valid;
+	int		pending;
+}	t_aa;
+
+/*
+** Fixed-point magnitude with sign: limb[0] is the integer part, every
+** following limb adds 32 fractional bits.
+*/
+typedef struct s_big
+{
+	int				neg;
+	unsigned int	limb[BIG_LIMBS];
+}	t_big;
+
+typedef struct s_orbit
+{
+	double	*zr;
+	double	*zi;
+	int		len;
+}	t_orbit;
+
+/*
+** Deep zoom state. Below DEEP_SPACING the view doubles are offsets from
+** `origin`, which is kept at the view center; pixels are iterated as
+** perturbations of reference orbits computed there in t_big precision.
+*/
+typedef struct s_deep
+{
+	t_big	origin[2];
+	int		based;
+	int		active;
+	int		julia;
+	int		valid;
+	int		key_iter;
+	double	key_c[2];
+	int		capacity;
+	t_orbit	orbit[2];
+	int		skip;
+	double	radius;
+	double	series[6];
+}	t_deep;
+
+typedef struct s_batch
+{
+	double			zr[BATCH_SIZE];
+	double			zi[BATCH_SIZE];
+	double			cr[BATCH_SIZE];
+	double			ci[BATCH_SIZE];
+	int				iter[BATCH_SIZE];
+	int				steps[BATCH_SIZE];
+	float			smooth[BATCH_SIZE];
+	int				n;
+	int				max_iter;
+	int				flags;
+	int				power;
+	const t_deep	*deep;
+}	t_batch;
+
+/*
+** A row being resumed: batch 0 continues orbits that all stopped at
+** base[0], batch 1 starts over the pixels whose z was not kept.
+*/
+typedef struct s_resume
+{
+	t_batch	batch[2];
+	int		x[2][BATCH_SIZE];
+	int		base[2];
+	int		y;
+}	t_resume;
+
+typedef void				(*t_kernel)(t_batch *b);
+typedef struct s_fractal	t_fractal;
+
+/*
+** An entry of the formula registry in formulas.c. kernels[precision] holds
+** the scalar kernel and its SSE2, AVX2 and AVX-512 counterparts; load
+** puts a pixel into a batch as z0 and c.
+*/
+typedef struct s_formula
+{
+	const char		*name;
+	t_fractal_type	type;
+	int				params;
+	int				power;
+	int				flags;
+	void			(*load)(t_fractal *fract, t_batch *b, int i, double c[2]);
+	t_kernel		kernels[3][4];
+}	t_formula;
+
+/*
+** Everything a cached tile's counts depend on: the lattice spacing, the
+** tile's position on it and the parameters of the iteration.
+*/
+typedef struct s_tile_key
+{
+	double		spacing;
+	long		tx;
+	long		ty;
+	double		c[2];
+	int			type;
+	int			max_iter;
+	int			flags;
+	t_kernel	kernel;
+}	t_tile_key;
+
+typedef struct s_counts
+{
+	int		iter[TILE_SIZE * TILE_SIZE];
+	float	smooth[TILE_SIZE * TILE_SIZE];
+}	t_counts;
+
+/*
+** A cached lattice tile. Only the tile-local rect {x0, y0, x1, y1} of its
+** counts is filled; the entry sits in a hash chain and in the LRU list,
+** most recently used first.
+*/
+typedef struct s_cached
+{
+	t_tile_key		key;
+	int				rect[4];
+	struct s_cached	*chain;
+	struct s_cached	*prev;
+	struct s_cached	*next;
+	t_counts		counts;
+}	t_cached;
+
+typedef struct s_cache
+{
+	pthread_mutex_t	lock;
+	t_cached		**table;
+	long			mask;
+	t_cached		*head;
+	t_cached		*tail;
+	size_t			used;
+	size_t			cap;
+}	t_cache;
+
+/*
+** One level of a precomputed tile store: nx x ny lattice tiles from
+** (tx, ty) at the given spacing, computed with kernels[tier]. Their tiles
+** are numbered from `first`, row by row.
+*/
+typedef struct s_store_level
+{
+	double	spacing;
+	long	tx;
+	long	ty;
+	long	nx;
+	long	ny;
+	long	first;
+	int		tier;
+}	t_store_level;
+
+/*
+** Start of a tile store file. It is followed by one done byte per tile
+** and, from the next page boundary on, by the tiles themselves.
+*/
+typedef struct s_store_head
+{
+	char			magic[8];
+	int				version;
+	int				type;
+	double			c[2];
+	int				max_iter;
+	int				flags;
+	int				levels;
+	long			tiles;
+	t_store_level	level[STORE_LEVELS];
+}	t_store_head;
+
+typedef struct s_store
+{
+	unsigned char	*map;
+	size_t			size;
+	t_store_head	*head;
+	unsigned char	*done;
+	t_counts		*tiles;
+}	t_store;
+
+typedef void				(*t_job)(t_fractal *fract, int tile);
+typedef int					(*t_check)(t_fractal *fract, const char *name,
+	int *iter, float *smooth);
+
+/*
+** A view of the verify suite: its arguments, the name standing for argv[0],
+** and whether it is checked against the scalar render (VIEW_SCALAR), its
+** golden file (VIEW_GOLDEN) or both.
+*/
+typedef struct s_view
+{
+	const char	*argv[12];
+	int			checks;
+}	t_view;
+
+/*
+** Hot path counters of one reporting period, in nanoseconds where timed.
+** iterate and color are summed over the threads doing the work, busy per
+** thread; aa, blit and pool are wall time on the calling thread, pool
+** being the time spent waiting in pool_run(). iterations sums the counts
+** of computed pixels, shortcut ones included. Workers add with atomics;
+** the period is only closed while the pool is idle.
+*/
+typedef struct s_stats
+{
+	long	start;
+	long	period;
+	long	iterate;
+	long	color;
+	long	aa;
+	long	blit;
+	long	pool;
+	long	iterations;
+	long	frames;
+	long	cache_hits;
+	long	cache_misses;
+	long	busy[MAX_THREADS];
+}	t_stats;
+
+/*
+** The window's render thread. Hooks bump generation to cancel its work;
+** started is the generation the current work belongs to. It draws into
+** img[back] and publishes finished steps as `ready`, which loop_hook()
+** puts on the window and keeps as `front`. busy is set while it works.
+*/
+typedef struct s_async
+{
+	pthread_t		thread;
+	pthread_mutex_t	lock;
+	pthread_cond_t	wake;
+	pthread_cond_t	idle;
+	int				generation;
+	int				started;
+	int				busy;
+	int				quit;
+	int				running;
+	int				redraw;
+	void			*img[2];
+	char			*addr[2];
+	int				back;
+	int				front;
+	int				ready;
+}	t_async;
+
+/*
+** Automatic max_iter and the per-frame time budget. Without --iter the
+** count follows the zoom depth times `scale`, which the escape counts of
+** each view's first pass double or halve. sample_ns is the cost of one
+** sample in the last preview pass, taken at sample_iter; with --budget the
+** first pass is the finest one predicted to fit in budget_ms.
+*/
+typedef struct s_tuning
+{
+	int		auto_iter;
+	double	scale;
+	int		budget_ms;
+	double	sample_ns;
+	int		sample_iter;
+}	t_tuning;
+
+typedef struct s_thread_data
+{
+	t_fractal	*fract;
+	int			thread_id;
+}	t_thread_data;
+
+typedef struct s_pool
+{
+	pthread_mutex_t	lock;
+	pthread_cond_t	wake;
+	pthread_cond_t	done;
+	t_job			job;
+	int				generation;
+	int				next_tile;
+	int				num_tiles;
+	int				busy;
+	int				quit;
+	int				num_threads;
+	pthread_t		threads[MAX_THREADS];
+	t_thread_data	thread_data[MAX_THREADS];
+}	t_pool;
+
+typedef struct s_options
+{
+	const char	*out;
+	const char	*center_text[2];
+	double		center[2];
+	double		span;
+	const char	*store;
+	int			levels;
+	int			port;
+	int			budget;
+	int			power;
+}	t_options;
+
+typedef struct s_tile
+{
+	t_fractal	*fract;
+	int			rect[4];
+	int			width;
+	int			iter[TILE_SIZE * TILE_SIZE];
+	float		smooth[TILE_SIZE * TILE_SIZE];
+	int			slot[BATCH_SIZE];
+	long		iterations;
+	t_batch		batch;
+}	t_tile;
+
+typedef struct s_png
+{
+	FILE			*file;
+	unsigned char	buf[IDAT_SIZE];
+	int				len;
+	unsigned int	adler[2];
+	int				error;
+}	t_png;
+
+/*
+** A connection whose request head is still arriving. The accept loop
+** polls all of them, so a slow client only holds up itself.
+*/
+typedef struct s_client
+{
+	int		fd;
+	int		len;
+	long	since;
+	char	head[SERVE_HEAD];
+}	t_client;
+
+/*
+** A tile request of the daemon and the clients waiting for it; identical
+** requests arriving while it is queued or rendering join its clients.
+*/
+typedef struct s_request
+{
+	int		state;
+	long	seq;
+	int		type;
+	int		z;
+	long	x;
+	long	y;
+	int		clients[SERVE_WAITERS];
+	int		count;
+}	t_request;
+
+typedef struct s_worker
+{
+	struct s_server	*server;
+	t_fractal		*fract;
+	pthread_t		thread;
+}	t_worker;
+
+typedef struct s_server
+{
+	pthread_mutex_t	lock;
+	pthread_cond_t	ready;
+	t_request		queue[SERVE_QUEUE];
+	long			seq;
+	int				stop;
+	t_worker		workers[SERVE_WORKERS];
+	int				num_workers;
+}	t_server;
+
+struct s_fractal
 {
 	void			*mlx;
 	void			*win;
@@ -21,6 +526,8 @@ typedef struct s_fractal
 	int				bpp;
 	int				line_len;
 	int				endian;
+	int				width;
+	int				height;
 	double			min_re;
 	double			max_re;
 	double			min_im;
@@ -28,17 +535,183 @@ typedef struct s_fractal
 	double			c_re;
 	double			c_im;
 	t_fractal_type	type;
+	const t_formula	*formula;
+	int				power;
 	int				max_iter;
-}	t_fractal;
+	t_tuning		tuning;
+	int				shortcuts;
+	int				subdivide;
+	t_color_palette	palette;
+	double			color_shift;
+	int				animate;
+	int				smooth;
+	t_palette		colors;
+	int				*iters;
+	float			*smooth_iters;
+	double			*orbits;
+	t_aa			aa;
+	t_cache			cache;
+	t_store			store;
+	int				cached;
+	long			lattice[2];
+	int				tile_shift[2];
+	t_deep			deep;
+	double			factors[2];
+	int				step;
+	int				refining;
+	int				refine;
+	int				resume;
+	int				first_pass;
+	int				blocks;
+	int				warp;
+	int				strips[2][4];
+	int				num_strips;
+	int				region[4];
+	char			*prev;
+	size_t			prev_size;
+	double			prev_view[4];
+	int				prev_iter;
+	t_kernel		iterate;
+	t_kernel		kernels[3];
+	t_precision		precision;
+	int				tiles_x;
+	t_pool			pool;
+	t_async			async;
+	t_stats			stats;
+	t_stats			shown;
+	int				show_info;
+	int				report;
+};
 
 int		mandelbrot(double cr, double ci, int max_iter);
 int		julia(double zr, double zi, double cr, double ci, int max_iter);
-int		get_color(int iter, int max_iter);
-void	render_fractal(t_fractal *fract);
+int		get_color(const t_palette *p, int iter);
+int		get_smooth_color(const t_palette *p, int iter, float smooth);
+int		hsv_to_rgb(double h, double s, double v);
+void	palette_update(t_fractal *fract);
+void	palette_free(t_palette *p);
+int		alloc_iters(t_fractal *fract, int width, int height);
+int		alloc_orbits(t_fractal *fract, int width, int height);
+void	keep_orbit(t_fractal *fract, t_batch *b, int i, int pos[2]);
+void	forget_orbits(t_fractal *fract, int rect[4]);
+void	resume_pass(t_fractal *fract, int step);
+void	fill_block(t_fractal *fract, int pos[2], int iter, float smooth);
+void	color_rect(t_fractal *fract, int rect[4]);
+void	recolor(t_fractal *fract);
+void	antialias(t_fractal *fract, int rect[4]);
+void	aa_free(t_aa *aa);
+void	iterate_scalar(t_batch *b);
+void	iterate_sse2(t_batch *b);
+void	iterate_avx2(t_batch *b);
+void	iterate_avx512(t_batch *b);
+void	iterate_float(t_batch *b);
+void	iterate_long(t_batch *b);
+void	iterate_sse2_f32(t_batch *b);
+void	iterate_avx2_f32(t_batch *b);
+void	iterate_avx512_f32(t_batch *b);
+const t_formula	*find_formula(const char *name);
+void	set_formula(t_fractal *fract, t_fractal_type type);
+void	formula_params(t_fractal *fract, double c[2]);
+int		in_bulbs(double cr, double ci);
+void	smooth_batch(t_batch *b);
+void	plain_batch(t_batch *b);
+void	init_batch(t_fractal *fract, t_batch *b);
+void	run_batch(t_fractal *fract, t_batch *b);
+void	iterate_perturb(t_batch *b);
+void	deep_origin(t_fractal *fract, const char *text[2], double span);
+void	deep_update(t_fractal *fract);
+void	deep_free(t_fractal *fract);
+void	big_from_double(t_big *r, double x);
+void	big_from_str(t_big *r, const char *s);
+double	big_to_double(const t_big *a);
+void	big_add(t_big *r, const t_big *a, const t_big *b);
+void	big_mul(t_big *r, const t_big *a, const t_big *b);
+int		cache_init(t_cache *cache);
+void	cache_free(t_cache *cache);
+int		cache_fetch(t_fractal *fract, int rect[4]);
+void	cache_store(t_fractal *fract, int rect[4]);
+int		cache_has(t_fractal *fract, int rect[4]);
+int		tile_flags(t_fractal *fract);
+size_t	store_size(const t_store_head *head);
+int		store_map(t_store *store, int fd, const t_store_head *head,
+			int prot);
+int		store_open(t_store *store, const char *path);
+void	store_close(t_store *store);
+const t_counts	*store_tile(t_fractal *fract, const t_tile_key *key);
+double	lattice_spacing(double spacing, int step);
+double	lattice_zoom(t_fractal *fract, double zoom);
+void	snap_view(t_fractal *fract);
+void	lattice_update(t_fractal *fract);
+int		cache_covers(t_fractal *fract);
+int		prepare_region(t_fractal *fract);
+void	select_precision(t_fractal *fract);
+void	tile_rect(t_fractal *fract, int tile, int rect[4]);
+void	subdivide_tile(t_fractal *fract, int tile);
+void	set_view(t_fractal *fract, double re, double im, double span);
+void	render_pass(t_fractal *fract, int step, int refining);
+void	render_rect(t_fractal *fract, int rect[4]);
+void	update_factors(t_fractal *fract);
+void	render_image(t_fractal *fract);
+void	tune_iter(t_fractal *fract);
+int		first_step(t_fractal *fract);
+int		next_pass(t_fractal *fract, long ns);
+int		next_resume(t_fractal *fract);
+void	tune_image(t_fractal *fract);
+void	*render_thread(void *arg);
+void	pool_init(t_fractal *fract);
+void	pool_run(t_fractal *fract, t_job job, int num_tiles);
+void	pool_destroy(t_pool *pool);
+int		render_cancelled(t_fractal *fract);
 int		key_hook(int keycode, t_fractal *fract);
 int		mouse_hook(int button, int x, int y, t_fractal *fract);
 int		close_hook(t_fractal *fract);
+int		loop_hook(t_fractal *fract);
+void	render_fractal(t_fractal *fract);
+int		save_frame(t_fractal *fract);
+void	reproject(t_fractal *fract);
+void	pan_view(t_fractal *fract, int dx, int dy);
+int		resize_hook(t_fractal *fract);
+int		resize_fractal(t_fractal *fract, int width, int height);
+void	allow_resize(t_fractal *fract);
+void	present(t_fractal *fract);
+int		render_pending(t_fractal *fract);
+void	start_render(t_fractal *fract);
+void	stop_render(t_fractal *fract);
+void	publish(t_fractal *fract);
+int		async_images(t_fractal *fract, int width, int height);
+int		async_start(t_fractal *fract);
+void	async_stop(t_fractal *fract);
+long	stats_now(void);
+void	stats_add(long *counter, long value);
+void	stats_init(t_fractal *fract);
+int		stats_tick(t_fractal *fract, int force);
+int		stats_threads(t_fractal *fract);
+void	draw_hud(t_fractal *fract);
 void	print_usage(void);
+void	init_fractal(t_fractal *fract);
+int		parse_args(int argc, char **argv, t_fractal *fract, t_options *opt);
+int		run_command(int argc, char **argv);
+int		parse_options(int argc, char **argv, t_fractal *fract,
+			t_options *opt);
+int		render_headless(int argc, char **argv);
+int		alloc_buffer(t_fractal *fract);
+int		precompute(int argc, char **argv);
+int		write_png_stream(t_fractal *fract, FILE *file);
+int		serve(int argc, char **argv);
+void	serve_respond(int fd, const char *status, const char *body,
+			size_t len);
+int		serve_start(t_server *server, int argc, char **argv);
+int		serve_enqueue(t_server *server, const t_request *req, int client);
+void	serve_stop(t_server *server);
+int		bench(int argc, char **argv);
+int		verify(int argc, char **argv);
+int		verify_view(const char *const *view, const char *size,
+			t_check check);
+const t_view	*verify_views(int *count);
+int		compare_counts(t_fractal *fract, const char *name, int *iter,
+			float *smooth);
+int		golden_suite(int record);
+int		save_image(t_fractal *fract, const char *path);
 int		ft_strcmp(const char *s1, const char *s2);
 double	ft_atof(const char *str);
 double	is_it_double(const char **s);
@@ -0,0 +1,166 @@
+#include "fract.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+** Golden views: small renders whose counts are checked in under
+** VERIFY_GOLDEN. The scalar cross-check of verify.c shares the kernels'
+** formulas, the smooth count and the perturbation path with what it
+** checks, so a change there only shows up against counts recorded before
+** it. `verify --record` rewrites the files after an intended change.
+*/
+static int	g_record;
+
+/*
+** A golden file is text: "width height smooth", then the counts a row per
+** line, then as many rows of smooth counts when smooth is 1.
+*/
+static int	write_golden(t_fractal *fract, const char *path)
+{
+	FILE	*file;
+	long	i;
+
+	file = fopen(path, "w");
+	if (!file)
+	{
+		printf("Error: Cannot write '%s'\n", path);
+		return (1);
+	}
+	fprintf(file, "%d %d %d\n", fract->width, fract->height, fract->smooth);
+	i = -1;
+	while (++i < (long)fract->width * fract->height)
+		fprintf(file, "%d%c", fract->iters[i],
+			" \n"[(i + 1) % fract->width == 0]);
+	i = -1;
+	while (fract->smooth && ++i < (long)fract->width * fract->height)
+		fprintf(file, "%.4f%c", fract->smooth_iters[i],
+			" \n"[(i + 1) % fract->width == 0]);
+	printf("wrote %s\n", path);
+	return (fclose(file) != 0);
+}
+
+static int	read_golden(t_fractal *fract, const char *path, int *iter,
+		float *smooth)
+{
+	FILE	*file;
+	int		head[3];
+	long	n;
+	long	i;
+
+	file = fopen(path, "r");
+	if (!file)
+		return (1);
+	n = (long)fract->width * fract->height;
+	i = 0;
+	if (fscanf(file, "%d %d %d", head, head + 1, head + 2) == 3
+		&& head[0] == fract->width && head[1] == fract->height
+		&& head[2] == fract->smooth)
+	{
+		while (i < n && fscanf(file, "%d", iter + i) == 1)
+			i++;
+		while (fract->smooth && i >= n && i < 2 * n
+			&& fscanf(file, "%f", smooth + i - n) == 1)
+			i++;
+	}
+	fclose(file);
+	return (i < n + fract->smooth * n);
+}
+
+/*
+** Renders the view and compares it with its golden file. A view reading a
+** store must have taken tiles from it, or the store went unchecked.
+*/
+static int	check_golden(t_fractal *fract, const char *name, int *iter,
+		float *smooth)
+{
+	char	path[256];
+	char	label[64];
+	int		status;
+
+	fract->subdivide = 0;
+	render_image(fract);
+	snprintf(path, sizeof(path), "%s/%s.txt", VERIFY_GOLDEN, name);
+	if (g_record)
+		return (write_golden(fract, path));
+	snprintf(label, sizeof(label), "golden %s", name);
+	if (read_golden(fract, path, iter, smooth))
+	{
+		printf("FAIL  %-32s cannot read %s\n", label, path);
+		return (1);
+	}
+	status = compare_counts(fract, label, iter, smooth);
+	if (fract->store.map && fract->stats.cache_hits == 0)
+	{
+		printf("FAIL  %-32s no tile came from the store\n", label);
+		status = 1;
+	}
+	return (status);
+}
+
+/*
+** The store view first precomputes its store, for the same view and size,
+** into a temporary file.
+*/
+static int	check_store(void)
+{
+	char		path[32];
+	const char	*view[15];
+	int			status;
+	int			fd;
+
+	snprintf(path, sizeof(path), "/tmp/fractol-verify-XXXXXX");
+	fd = mkstemp(path);
+	if (fd < 0)
+	{
+		printf("Error: Cannot create a temporary store\n");
+		return (1);
+	}
+	close(fd);
+	view[0] = "store";
+	view[1] = "mandelbrot";
+	view[2] = "--iter";
+	view[3] = "500";
+	view[4] = "--smooth";
+	view[5] = "--center";
+	view[6] = "-0.75";
+	view[7] = "0.1";
+	view[8] = "--span";
+	view[9] = "0.05";
+	view[10] = "--store";
+	view[11] = path;
+	view[12] = "--size";
+	view[13] = VERIFY_GOLDEN_SIZE;
+	view[14] = NULL;
+	status = precompute(14, (char **)view);
+	view[12] = NULL;
+	if (!status)
+		status = verify_view(view, VERIFY_GOLDEN_SIZE, check_golden);
+	unlink(path);
+	return (status);
+}
+
+/*
+** Runs the golden views of the verify suite at VERIFY_GOLDEN_SIZE, or
+** with record set writes their files from this build. Returns 1 when any
+** check fails.
+*/
+int	golden_suite(int record)
+{
+	const t_view	*views;
+	int				count;
+	int				status;
+	int				n;
+
+	g_record = record;
+	views = verify_views(&count);
+	status = 0;
+	n = 0;
+	while (n < count)
+	{
+		if (views[n].checks & VIEW_GOLDEN)
+			status |= verify_view(views[n].argv, VERIFY_GOLDEN_SIZE,
+					check_golden);
+		n++;
+	}
+	return (status | check_store());
+}
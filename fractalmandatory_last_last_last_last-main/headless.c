@@ -0,0 +1,71 @@
+#include "fract.h"
+#include <stdlib.h>
+
+int	alloc_buffer(t_fractal *fract)
+{
+	fract->mlx = NULL;
+	fract->win = NULL;
+	fract->img = NULL;
+	fract->bpp = 32;
+	fract->line_len = fract->width * 4;
+	fract->endian = 0;
+	fract->addr = malloc((size_t)fract->line_len * fract->height);
+	if (!fract->addr)
+	{
+		printf("Error: Cannot allocate a %dx%d image\n",
+			fract->width, fract->height);
+		return (1);
+	}
+	if (alloc_iters(fract, fract->width, fract->height))
+	{
+		free(fract->addr);
+		return (1);
+	}
+	return (0);
+}
+
+/*
+** `./fractol render <fractal> [parameters] [options]`: renders one frame into
+** a plain malloc'd buffer through the same tile pool and kernels as the
+** window, writes it with save_image() and exits. Never touches MiniLibX, so
+** it runs on machines without an X display.
+*/
+int	render_headless(int argc, char **argv)
+{
+	t_fractal	fract;
+	t_options	opt;
+	int			status;
+
+	init_fractal(&fract);
+	if (argc < 2)
+		print_usage();
+	if (argc < 2 || parse_args(argc, argv, &fract, &opt))
+		return (1);
+	if (!opt.out)
+	{
+		printf("Error: render requires --out <file.ppm|file.png>\n");
+		return (1);
+	}
+	if (opt.store && store_open(&fract.store, opt.store))
+		return (1);
+	if (opt.store)
+	{
+		deep_update(&fract);
+		snap_view(&fract);
+	}
+	if (alloc_buffer(&fract))
+		return (1);
+	pool_init(&fract);
+	render_image(&fract);
+	stats_tick(&fract, 1);
+	pool_destroy(&fract.pool);
+	status = save_image(&fract, opt.out);
+	free(fract.addr);
+	free(fract.iters);
+	free(fract.smooth_iters);
+	aa_free(&fract.aa);
+	store_close(&fract.store);
+	deep_free(&fract);
+	palette_free(&fract.colors);
+	return (status);
+}
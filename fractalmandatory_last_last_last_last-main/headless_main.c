@@ -0,0 +1,23 @@
+#include "fract.h"
+#include <stdio.h>
+
+/*
+** Entry point of fractol_headless: the same commands as fractol_bonus
+** without the window, built without MiniLibX or X11 so bench and verify
+** run on machines that have neither.
+*/
+int	main(int argc, char **argv)
+{
+	int	status;
+
+	status = -1;
+	if (argc >= 2)
+		status = run_command(argc, argv);
+	if (status >= 0)
+		return (status);
+	if (argc >= 2)
+		printf("Error: '%s' needs the window, run it with fractol_bonus\n\n",
+			argv[1]);
+	print_usage();
+	return (1);
+}
@@ -2,22 +2,117 @@
 #include "minilibx-linux/mlx.h"
 #include <stdlib.h>
 
+/*
+** Anti-aliasing applies to complete frames: a frame still being refined
+** gets it from its last pass.
+*/
+static void	toggle_aa(t_fractal *fract)
+{
+	fract->aa.on = !fract->aa.on;
+	fract->aa.valid = 0;
+	fract->aa.pending = fract->aa.on && !fract->refine;
+	if (!fract->aa.on)
+	{
+		recolor(fract);
+		publish(fract);
+	}
+}
+
+/*
+** The keys that change settings. The render thread is stopped first, so
+** the hook owns the buffers; loop_hook() restarts it on what is pending.
+*/
+static void	toggle_key(int keycode, t_fractal *fract)
+{
+	stop_render(fract);
+	if (keycode == E_KEY)
+		fract->shortcuts ^= SHORTCUT_BULBS | SHORTCUT_PERIOD;
+	else if (keycode == M_KEY)
+		fract->subdivide = !fract->subdivide;
+	else if (keycode == C_KEY)
+		fract->palette = (fract->palette + 1) % NUM_PALETTES;
+	else if (keycode == G_KEY)
+		fract->smooth = !fract->smooth;
+	if (keycode == X_KEY)
+		toggle_aa(fract);
+	else if (keycode == C_KEY || (keycode == G_KEY && !fract->smooth))
+	{
+		recolor(fract);
+		publish(fract);
+	}
+	else
+		render_fractal(fract);
+}
+
+/*
+** Doubles or halves max_iter and takes it out of automatic tuning. Raising
+** it on a complete frame continues the orbits the old cap stopped rather
+** than rendering the view again.
+*/
+static void	change_iter(t_fractal *fract, int raise)
+{
+	stop_render(fract);
+	fract->tuning.auto_iter = 0;
+	if (raise && fract->max_iter > 1000000000 / 2)
+		return ;
+	if (!raise && fract->max_iter < 2)
+		return ;
+	if (raise)
+		fract->max_iter *= 2;
+	else
+		fract->max_iter /= 2;
+	if (raise && fract->orbits && !render_pending(fract) && !fract->warp)
+		fract->resume = 1;
+	else
+		render_fractal(fract);
+}
+
 int	key_hook(int keycode, t_fractal *fract)
 {
 	if (keycode == ESC_KEY)
+		close_hook(fract);
+	else if (keycode == W_KEY || keycode == UP_KEY)
+		pan_view(fract, 0, -fract->height / PAN_DIVISOR);
+	else if (keycode == S_KEY || keycode == DOWN_KEY)
+		pan_view(fract, 0, fract->height / PAN_DIVISOR);
+	else if (keycode == A_KEY || keycode == LEFT_KEY)
+		pan_view(fract, -fract->width / PAN_DIVISOR, 0);
+	else if (keycode == D_KEY || keycode == RIGHT_KEY)
+		pan_view(fract, fract->width / PAN_DIVISOR, 0);
+	else if (keycode == E_KEY || keycode == M_KEY || keycode == C_KEY
+		|| keycode == G_KEY || keycode == X_KEY)
+		toggle_key(keycode, fract);
+	else if (keycode == PLUS_KEY || keycode == KP_PLUS_KEY)
+		change_iter(fract, 1);
+	else if (keycode == MINUS_KEY || keycode == KP_MINUS_KEY)
+		change_iter(fract, 0);
+	else if (keycode == SPACE_KEY)
+		fract->animate = !fract->animate;
+	else if (keycode == I_KEY)
 	{
-		mlx_destroy_image(fract->mlx, fract->img);
-		mlx_destroy_window(fract->mlx, fract->win);
-		mlx_destroy_display(fract->mlx);
-		free(fract->mlx);
-		exit(0);
+		pthread_mutex_lock(&fract->async.lock);
+		fract->show_info = !fract->show_info;
+		fract->async.redraw = 1;
+		pthread_mutex_unlock(&fract->async.lock);
 	}
 	return (0);
 }
 
 int	close_hook(t_fractal *fract)
 {
-	mlx_destroy_image(fract->mlx, fract->img);
+	async_stop(fract);
+	pool_destroy(&fract->pool);
+	free(fract->prev);
+	free(fract->iters);
+	free(fract->smooth_iters);
+	free(fract->orbits);
+	aa_free(&fract->aa);
+	cache_free(&fract->cache);
+	store_close(&fract->store);
+	deep_free(fract);
+	palette_free(&fract->colors);
+	mlx_destroy_image(fract->mlx, fract->async.img[0]);
+	mlx_destroy_image(fract->mlx, fract->async.img[1]);
 	mlx_destroy_window(fract->mlx, fract->win);
 	mlx_destroy_display(fract->mlx);
 	free(fract->mlx);
@@ -51,17 +146,25 @@ int	mouse_hook(int button, int x, int y, t_fractal *fract)
 	double	mouse[2];
 	double	zoom_factor;
 
-	mouse[0] = fract->min_re + (double)x * (fract->max_re
-			- fract->min_re) / WIDTH;
-	mouse[1] = fract->min_im + (double)y * (fract->max_im
-			- fract->min_im) / HEIGHT;
 	if (button == 4)
 		zoom_factor = 0.9;
 	else if (button == 5)
 		zoom_factor = 1.1;
 	else
 		return (0);
+	stop_render(fract);
+	mouse[0] = fract->min_re + (double)x * (fract->max_re
+			- fract->min_re) / fract->width;
+	mouse[1] = fract->min_im + (double)y * (fract->max_im
+			- fract->min_im) / fract->height;
+	if (zoom_factor < 1.0 && fract->max_re - fract->min_re
+		< MIN_SPACING * fract->width)
+		return (0);
+	zoom_factor = lattice_zoom(fract, zoom_factor);
+	if (!fract->warp && save_frame(fract) == 0)
+		fract->warp = 1;
 	calculate_zoom(fract, mouse, zoom_factor);
-	render_fractal(fract);
+	if (!fract->warp)
+		render_fractal(fract);
 	return (0);
 }
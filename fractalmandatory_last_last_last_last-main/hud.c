@@ -0,0 +1,42 @@
+#include "fract.h"
+#include "minilibx-linux/mlx.h"
+#include <math.h>
+#include <stdio.h>
+
+/*
+** Draws the last period's figures over the top left corner of the window,
+** as rates per second of wall time. Busy is the share of the pool time a
+** thread spent on tiles; a wide min/max gap means the load is unbalanced.
+*/
+void	draw_hud(t_fractal *fract)
+{
+	const t_stats	*s;
+	char			line[4][96];
+	double			t;
+	double			busy[2];
+	int				i;
+
+	s = &fract->shown;
+	t = s->period / 1e9 + (s->period == 0);
+	busy[0] = s->pool > 0;
+	busy[1] = 0.0;
+	i = -1;
+	while (++i < stats_threads(fract) && s->pool > 0)
+	{
+		busy[0] = fmin(busy[0], (double)s->busy[i] / s->pool);
+		busy[1] = fmax(busy[1], (double)s->busy[i] / s->pool);
+	}
+	snprintf(line[0], 96, "%.1f fps  %.3f Giter/s  %d threads",
+		s->frames / t, s->iterations / t / 1e9, stats_threads(fract));
+	snprintf(line[1], 96, "iterate %.0f  color %.0f  aa %.0f  blit %.0f ms/s",
+		s->iterate / t / 1e6, s->color / t / 1e6, s->aa / t / 1e6,
+		s->blit / t / 1e6);
+	snprintf(line[2], 96, "busy %.0f-%.0f%% of %.0f ms/s in pool",
+		busy[0] * 100, busy[1] * 100, s->pool / t / 1e6);
+	snprintf(line[3], 96, "cache %ld hits, %ld misses", s->cache_hits,
+		s->cache_misses);
+	i = -1;
+	while (++i < 4)
+		mlx_string_put(fract->mlx, fract->win, 10, 20 + 15 * i, HUD_COLOR,
+			line[i]);
+}
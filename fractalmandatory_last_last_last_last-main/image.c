@@ -0,0 +1,249 @@
+#include "fract.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int		g_crc_table[256];
+static pthread_once_t	g_crc_once = PTHREAD_ONCE_INIT;
+
+/*
+** Filled once through pthread_once: the serve workers write PNGs at the
+** same time.
+*/
+static void	crc32_table(void)
+{
+	unsigned int	c;
+	int				n;
+	int				k;
+
+	n = 0;
+	while (n < 256)
+	{
+		c = (unsigned int)n;
+		k = 0;
+		while (k++ < 8)
+			c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1u)));
+		g_crc_table[n++] = c;
+	}
+}
+
+static unsigned int	crc32_update(unsigned int crc, const unsigned char *p,
+		int len)
+{
+	pthread_once(&g_crc_once, crc32_table);
+	while (len-- > 0)
+		crc = g_crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return (crc);
+}
+
+static void	png_chunk(t_png *png, const char *type, const void *data,
+		int len)
+{
+	unsigned char	head[8];
+	unsigned int	crc;
+
+	head[0] = (unsigned char)(len >> 24);
+	head[1] = (unsigned char)(len >> 16);
+	head[2] = (unsigned char)(len >> 8);
+	head[3] = (unsigned char)len;
+	memcpy(head + 4, type, 4);
+	crc = crc32_update(0xFFFFFFFFu, head + 4, 4);
+	crc = crc32_update(crc, data, len) ^ 0xFFFFFFFFu;
+	fwrite(head, 1, 8, png->file);
+	fwrite(data, 1, len, png->file);
+	head[0] = (unsigned char)(crc >> 24);
+	head[1] = (unsigned char)(crc >> 16);
+	head[2] = (unsigned char)(crc >> 8);
+	head[3] = (unsigned char)crc;
+	fwrite(head, 1, 4, png->file);
+}
+
+/*
+** Appends bytes to the zlib stream and emits a full IDAT chunk whenever the
+** staging buffer fills up, so memory use does not grow with the image.
+*/
+static void	png_write(t_png *png, const unsigned char *data, int len)
+{
+	int	n;
+
+	while (len > 0)
+	{
+		n = IDAT_SIZE - png->len;
+		if (n > len)
+			n = len;
+		memcpy(png->buf + png->len, data, n);
+		png->len += n;
+		data += n;
+		len -= n;
+		if (png->len == IDAT_SIZE)
+		{
+			png_chunk(png, "IDAT", png->buf, png->len);
+			png->len = 0;
+		}
+	}
+}
+
+/*
+** Writes one filtered scanline as uncompressed deflate blocks. Stored
+** blocks keep the encoder dependency-free; the checksum is Adler-32 with
+** the modulo deferred over 5552-byte runs as zlib does.
+*/
+static void	png_stored(t_png *png, const unsigned char *row, int len,
+		int last)
+{
+	unsigned char	head[5];
+	int				n;
+	int				i;
+
+	while (len > 0)
+	{
+		n = len;
+		if (n > 65535)
+			n = 65535;
+		head[0] = (unsigned char)(last && n == len);
+		head[1] = (unsigned char)n;
+		head[2] = (unsigned char)(n >> 8);
+		head[3] = (unsigned char)~n;
+		head[4] = (unsigned char)(~n >> 8);
+		png_write(png, head, 5);
+		png_write(png, row, n);
+		i = 0;
+		while (i < n)
+		{
+			png->adler[0] += row[i++];
+			png->adler[1] += png->adler[0];
+			if (i % 5552 == 0 || i == n)
+			{
+				png->adler[0] %= 65521;
+				png->adler[1] %= 65521;
+			}
+		}
+		row += n;
+		len -= n;
+	}
+}
+
+static void	fill_rgb(t_fractal *fract, int y, unsigned char *dst)
+{
+	unsigned int	color;
+	int				x;
+
+	x = 0;
+	while (x < fract->width)
+	{
+		color = *(unsigned int *)(fract->addr + y * fract->line_len
+				+ x * (fract->bpp / 8));
+		*dst++ = (unsigned char)(color >> 16);
+		*dst++ = (unsigned char)(color >> 8);
+		*dst++ = (unsigned char)color;
+		x++;
+	}
+}
+
+static void	write_png(t_fractal *fract, t_png *png, unsigned char *row)
+{
+	unsigned char	ihdr[13];
+	int				y;
+
+	fwrite("\x89PNG\r\n\x1a\n", 1, 8, png->file);
+	y = 0;
+	while (y < 4)
+	{
+		ihdr[y] = (unsigned char)(fract->width >> (24 - 8 * y));
+		ihdr[4 + y] = (unsigned char)(fract->height >> (24 - 8 * y));
+		y++;
+	}
+	memcpy(ihdr + 8, "\x08\x02\x00\x00\x00", 5);
+	png_chunk(png, "IHDR", ihdr, 13);
+	png->len = 0;
+	png->adler[0] = 1;
+	png->adler[1] = 0;
+	png_write(png, (const unsigned char *)"\x78\x01", 2);
+	y = 0;
+	while (y < fract->height)
+	{
+		row[0] = 0;
+		fill_rgb(fract, y, row + 1);
+		png_stored(png, row, 1 + 3 * fract->width, y == fract->height - 1);
+		y++;
+	}
+	ihdr[0] = (unsigned char)(png->adler[1] >> 8);
+	ihdr[1] = (unsigned char)png->adler[1];
+	ihdr[2] = (unsigned char)(png->adler[0] >> 8);
+	ihdr[3] = (unsigned char)png->adler[0];
+	png_write(png, ihdr, 4);
+	png_chunk(png, "IDAT", png->buf, png->len);
+	png_chunk(png, "IEND", "", 0);
+}
+
+/*
+** PNG encoding of the current frame into an open stream, for the tile
+** daemon. Returns nonzero on a write error.
+*/
+int	write_png_stream(t_fractal *fract, FILE *file)
+{
+	t_png			*png;
+	unsigned char	*row;
+
+	png = malloc(sizeof(t_png));
+	row = malloc(1 + 3 * (size_t)fract->width);
+	if (png && row)
+	{
+		png->file = file;
+		write_png(fract, png, row);
+	}
+	free(png);
+	free(row);
+	return (!png || !row || ferror(file));
+}
+
+static int	is_png(const char *path)
+{
+	int	len;
+
+	len = 0;
+	while (path[len])
+		len++;
+	return (len >= 4 && ft_strcmp(path + len - 4, ".png") == 0);
+}
+
+/*
+** Writes the current frame to `path`: PNG when the name ends in ".png",
+** binary PPM (P6) otherwise.
+*/
+int	save_image(t_fractal *fract, const char *path)
+{
+	t_png			*png;
+	unsigned char	*row;
+	int				y;
+	int				failed;
+
+	png = malloc(sizeof(t_png));
+	row = malloc(1 + 3 * (size_t)fract->width);
+	if (png)
+		png->file = fopen(path, "wb");
+	if (!png || !row || !png->file)
+	{
+		printf("Error: Cannot write '%s'\n", path);
+		free(png);
+		free(row);
+		return (1);
+	}
+	if (is_png(path))
+		write_png(fract, png, row);
+	else
+	{
+		fprintf(png->file, "P6\n%d %d\n255\n", fract->width, fract->height);
+		y = 0;
+		while (y < fract->height)
+		{
+			fill_rgb(fract, y++, row);
+			fwrite(row, 1, 3 * (size_t)fract->width, png->file);
+		}
+	}
+	failed = ferror(png->file) | fclose(png->file);
+	if (failed)
+		printf("Error: Cannot write '%s'\n", path);
+	free(png);
+	free(row);
+	return (failed != 0);
+}
@@ -0,0 +1,525 @@
+#include "fract.h"
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+#endif
+
+/*
+** Main cardioid and period-2 bulb test for Mandelbrot points. Points inside
+** never escape, so they get max_iter without iterating.
+*/
+int	in_bulbs(double cr, double ci)
+{
+	double	x;
+	double	y2;
+	double	q;
+
+	x = cr - 0.25;
+	y2 = ci * ci;
+	q = x * x + y2;
+	if (q * (q + x) <= 0.25 * y2)
+		return (1);
+	x = cr + 1.0;
+	return (x * x + y2 <= 0.0625);
+}
+
+/*
+** With SMOOTH_COUNT an escaped orbit keeps going, uncounted, until |z|^2
+** passes SMOOTH_BAILOUT; steps[] receives the total for smooth_batch().
+*/
+static void	smooth_tail(t_batch *b, int i)
+{
+	double	tmp;
+
+	b->steps[i] = b->iter[i];
+	while (b->iter[i] < b->max_iter && b->steps[i] < b->max_iter
+		&& b->zr[i] * b->zr[i] + b->zi[i] * b->zi[i] <= SMOOTH_BAILOUT)
+	{
+		tmp = b->zr[i] * b->zr[i] - b->zi[i] * b->zi[i] + b->cr[i];
+		b->zi[i] = 2.0 * b->zr[i] * b->zi[i] + b->ci[i];
+		b->zr[i] = tmp;
+		b->steps[i]++;
+	}
+}
+
+/*
+** Continuous escape count n + 1 - log2(log2 |z|), where n counts every
+** step including the uncounted ones. Past the large bailout the result
+** no longer depends on how far beyond 2 the orbit jumped, so the bands
+** blend into each other. For a formula of degree d the log2 of the outer
+** one becomes log_d. Interior points keep max_iter.
+*/
+void	smooth_batch(t_batch *b)
+{
+	double	r2;
+	int		i;
+
+	i = 0;
+	while (i < b->n)
+	{
+		b->smooth[i] = b->max_iter;
+		r2 = fmax(b->zr[i] * b->zr[i] + b->zi[i] * b->zi[i], 4.0);
+		if (b->iter[i] < b->max_iter && b->power == 2)
+			b->smooth[i] = b->steps[i] + 2.0 - log2(log2(r2));
+		else if (b->iter[i] < b->max_iter)
+			b->smooth[i] = b->steps[i] + 1.0
+				- log2(0.5 * log2(r2)) / log2(b->power);
+		i++;
+	}
+}
+
+/*
+** The smooth counts of a formula without a continuous one, for views
+** shown with smooth coloring: its integer counts.
+*/
+void	plain_batch(t_batch *b)
+{
+	int	i;
+
+	i = -1;
+	while (++i < b->n)
+		b->smooth[i] = b->iter[i];
+}
+
+/*
+** Brent-style cycle detection: z is saved at iterations PERIOD_FIRST, twice
+** that, and so on, and an orbit that comes back within PERIOD_EPS of the
+** saved point has settled on an attracting cycle and is treated as inside.
+*/
+static void	iterate_point(t_batch *b, int i)
+{
+	double	tmp;
+	double	saved[2];
+	int		check;
+
+	b->iter[i] = 0;
+	if ((b->flags & SHORTCUT_BULBS) && in_bulbs(b->cr[i], b->ci[i]))
+		b->iter[i] = b->max_iter;
+	saved[0] = b->zr[i];
+	saved[1] = b->zi[i];
+	check = PERIOD_FIRST;
+	while (b->zr[i] * b->zr[i] + b->zi[i] * b->zi[i] <= 4.0
+		&& b->iter[i] < b->max_iter)
+	{
+		tmp = b->zr[i] * b->zr[i] - b->zi[i] * b->zi[i] + b->cr[i];
+		b->zi[i] = 2.0 * b->zr[i] * b->zi[i] + b->ci[i];
+		b->zr[i] = tmp;
+		b->iter[i]++;
+		if ((b->flags & SHORTCUT_PERIOD) && fabs(b->zr[i] - saved[0])
+			< PERIOD_EPS && fabs(b->zi[i] - saved[1]) < PERIOD_EPS)
+			b->iter[i] = b->max_iter;
+		else if ((b->flags & SHORTCUT_PERIOD) && b->iter[i] == check)
+		{
+			saved[0] = b->zr[i];
+			saved[1] = b->zi[i];
+			check *= 2;
+		}
+	}
+	if (b->flags & SMOOTH_COUNT)
+		smooth_tail(b, i);
+}
+
+/*
+** Every kernel runs the same recurrence as mandelbrot() and julia():
+** z keeps iterating while |z|^2 <= 4 and the count is below max_iter.
+** Vector lanes that escape are masked out, so their z and count freeze
+** exactly where the scalar loop would have stopped. With SMOOTH_COUNT the
+** vector kernels keep a second mask of lanes that are still stepped
+** towards the smoothing bailout, like smooth_tail(). The Makefile builds
+** with -ffp-contract=off so neither side gets fused multiply-adds and
+** the counts stay bit-identical, shortcuts included.
+*/
+void	iterate_scalar(t_batch *b)
+{
+	int	i;
+
+	i = 0;
+	while (i < b->n)
+		iterate_point(b, i++);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+static __m128d	sse2_select(__m128d mask, __m128d yes, __m128d no)
+{
+	return (_mm_or_pd(_mm_and_pd(mask, yes), _mm_andnot_pd(mask, no)));
+}
+
+__attribute__((target("sse2")))
+static __m128d	sse2_shortcut(t_batch *b, int i, __m128d z[4], int k)
+{
+	__m128d	x;
+	__m128d	y2;
+	__m128d	q;
+	__m128d	sign;
+
+	if (k == 0)
+	{
+		x = _mm_sub_pd(_mm_loadu_pd(b->cr + i), _mm_set1_pd(0.25));
+		y2 = _mm_mul_pd(_mm_loadu_pd(b->ci + i), _mm_loadu_pd(b->ci + i));
+		q = _mm_add_pd(_mm_mul_pd(x, x), y2);
+		q = _mm_cmple_pd(_mm_mul_pd(q, _mm_add_pd(q, x)),
+				_mm_mul_pd(_mm_set1_pd(0.25), y2));
+		x = _mm_add_pd(_mm_loadu_pd(b->cr + i), _mm_set1_pd(1.0));
+		return (_mm_or_pd(q, _mm_cmple_pd(_mm_add_pd(_mm_mul_pd(x, x), y2),
+					_mm_set1_pd(0.0625))));
+	}
+	sign = _mm_set1_pd(-0.0);
+	x = _mm_andnot_pd(sign, _mm_sub_pd(z[0], z[2]));
+	q = _mm_andnot_pd(sign, _mm_sub_pd(z[1], z[3]));
+	return (_mm_and_pd(_mm_cmplt_pd(x, _mm_set1_pd(PERIOD_EPS)),
+			_mm_cmplt_pd(q, _mm_set1_pd(PERIOD_EPS))));
+}
+
+/*
+** z[0..1] is the orbit, z[2..3] the point saved for cycle detection.
+** m[0] marks the lanes still counted, m[1] the lanes still stepped, and
+** count[1] their number of steps.
+*/
+__attribute__((target("sse2"), always_inline))
+static inline void	sse2_group(t_batch *b, int i, int smooth)
+{
+	__m128d	z[4];
+	__m128d	sq[3];
+	__m128d	m[2];
+	__m128d	count[2];
+	int		k[2];
+
+	z[0] = _mm_loadu_pd(b->zr + i);
+	z[1] = _mm_loadu_pd(b->zi + i);
+	z[2] = z[0];
+	z[3] = z[1];
+	m[0] = _mm_castsi128_pd(_mm_set1_epi32(-1));
+	count[0] = _mm_setzero_pd();
+	if (b->flags & SHORTCUT_BULBS)
+	{
+		sq[0] = sse2_shortcut(b, i, z, 0);
+		m[0] = _mm_andnot_pd(sq[0], m[0]);
+		count[0] = sse2_select(sq[0], _mm_set1_pd(b->max_iter), count[0]);
+	}
+	m[1] = m[0];
+	count[1] = _mm_setzero_pd();
+	k[0] = 0;
+	k[1] = PERIOD_FIRST;
+	while (k[0] < b->max_iter)
+	{
+		sq[0] = _mm_mul_pd(z[0], z[0]);
+		sq[1] = _mm_mul_pd(z[1], z[1]);
+		sq[2] = _mm_add_pd(sq[0], sq[1]);
+		m[0] = _mm_and_pd(m[0], _mm_cmple_pd(sq[2], _mm_set1_pd(4.0)));
+		if (smooth)
+			m[1] = _mm_and_pd(m[1], _mm_cmple_pd(sq[2],
+						_mm_set1_pd(SMOOTH_BAILOUT)));
+		else
+			m[1] = m[0];
+		if (_mm_movemask_pd(m[1]) == 0)
+			break ;
+		sq[1] = _mm_add_pd(_mm_sub_pd(sq[0], sq[1]), _mm_loadu_pd(b->cr + i));
+		sq[0] = _mm_add_pd(_mm_mul_pd(_mm_add_pd(z[0], z[0]), z[1]),
+				_mm_loadu_pd(b->ci + i));
+		z[0] = sse2_select(m[1], sq[1], z[0]);
+		z[1] = sse2_select(m[1], sq[0], z[1]);
+		count[0] = _mm_add_pd(count[0], _mm_and_pd(m[0], _mm_set1_pd(1.0)));
+		if (smooth)
+			count[1] = _mm_add_pd(count[1], _mm_and_pd(m[1],
+						_mm_set1_pd(1.0)));
+		k[0]++;
+		if (b->flags & SHORTCUT_PERIOD)
+		{
+			sq[0] = _mm_and_pd(m[0], sse2_shortcut(b, i, z, k[0]));
+			count[0] = sse2_select(sq[0], _mm_set1_pd(b->max_iter), count[0]);
+			m[0] = _mm_andnot_pd(sq[0], m[0]);
+			m[1] = _mm_andnot_pd(sq[0], m[1]);
+			if (k[0] == k[1])
+			{
+				z[2] = z[0];
+				z[3] = z[1];
+				k[1] *= 2;
+			}
+		}
+	}
+	_mm_storeu_pd(b->zr + i, z[0]);
+	_mm_storeu_pd(b->zi + i, z[1]);
+	_mm_storel_epi64((__m128i *)(b->iter + i), _mm_cvtpd_epi32(count[0]));
+	_mm_storel_epi64((__m128i *)(b->steps + i), _mm_cvtpd_epi32(count[1]));
+}
+
+__attribute__((target("avx2")))
+static __m256d	avx2_shortcut(t_batch *b, int i, __m256d z[4], int k)
+{
+	__m256d	x;
+	__m256d	y2;
+	__m256d	q;
+	__m256d	sign;
+
+	if (k == 0)
+	{
+		x = _mm256_sub_pd(_mm256_loadu_pd(b->cr + i), _mm256_set1_pd(0.25));
+		y2 = _mm256_mul_pd(_mm256_loadu_pd(b->ci + i),
+				_mm256_loadu_pd(b->ci + i));
+		q = _mm256_add_pd(_mm256_mul_pd(x, x), y2);
+		q = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, x)),
+				_mm256_mul_pd(_mm256_set1_pd(0.25), y2), _CMP_LE_OQ);
+		x = _mm256_add_pd(_mm256_loadu_pd(b->cr + i), _mm256_set1_pd(1.0));
+		return (_mm256_or_pd(q, _mm256_cmp_pd(_mm256_add_pd(
+						_mm256_mul_pd(x, x), y2), _mm256_set1_pd(0.0625),
+					_CMP_LE_OQ)));
+	}
+	sign = _mm256_set1_pd(-0.0);
+	x = _mm256_andnot_pd(sign, _mm256_sub_pd(z[0], z[2]));
+	q = _mm256_andnot_pd(sign, _mm256_sub_pd(z[1], z[3]));
+	return (_mm256_and_pd(_mm256_cmp_pd(x, _mm256_set1_pd(PERIOD_EPS),
+				_CMP_LT_OQ), _mm256_cmp_pd(q, _mm256_set1_pd(PERIOD_EPS),
+				_CMP_LT_OQ)));
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline void	avx2_group(t_batch *b, int i, int smooth)
+{
+	__m256d	z[4];
+	__m256d	sq[3];
+	__m256d	m[2];
+	__m256d	count[2];
+	int		k[2];
+
+	z[0] = _mm256_loadu_pd(b->zr + i);
+	z[1] = _mm256_loadu_pd(b->zi + i);
+	z[2] = z[0];
+	z[3] = z[1];
+	m[0] = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+	count[0] = _mm256_setzero_pd();
+	if (b->flags & SHORTCUT_BULBS)
+	{
+		sq[0] = avx2_shortcut(b, i, z, 0);
+		m[0] = _mm256_andnot_pd(sq[0], m[0]);
+		count[0] = _mm256_blendv_pd(count[0], _mm256_set1_pd(b->max_iter),
+				sq[0]);
+	}
+	m[1] = m[0];
+	count[1] = _mm256_setzero_pd();
+	k[0] = 0;
+	k[1] = PERIOD_FIRST;
+	while (k[0] < b->max_iter)
+	{
+		sq[0] = _mm256_mul_pd(z[0], z[0]);
+		sq[1] = _mm256_mul_pd(z[1], z[1]);
+		sq[2] = _mm256_add_pd(sq[0], sq[1]);
+		m[0] = _mm256_and_pd(m[0], _mm256_cmp_pd(sq[2], _mm256_set1_pd(4.0),
+					_CMP_LE_OQ));
+		if (smooth)
+			m[1] = _mm256_and_pd(m[1], _mm256_cmp_pd(sq[2],
+						_mm256_set1_pd(SMOOTH_BAILOUT), _CMP_LE_OQ));
+		else
+			m[1] = m[0];
+		if (_mm256_movemask_pd(m[1]) == 0)
+			break ;
+		sq[1] = _mm256_add_pd(_mm256_sub_pd(sq[0], sq[1]),
+				_mm256_loadu_pd(b->cr + i));
+		sq[0] = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(z[0], z[0]), z[1]),
+				_mm256_loadu_pd(b->ci + i));
+		z[0] = _mm256_blendv_pd(z[0], sq[1], m[1]);
+		z[1] = _mm256_blendv_pd(z[1], sq[0], m[1]);
+		count[0] = _mm256_add_pd(count[0], _mm256_and_pd(m[0],
+					_mm256_set1_pd(1.0)));
+		if (smooth)
+			count[1] = _mm256_add_pd(count[1], _mm256_and_pd(m[1],
+						_mm256_set1_pd(1.0)));
+		k[0]++;
+		if (b->flags & SHORTCUT_PERIOD)
+		{
+			sq[0] = _mm256_and_pd(m[0], avx2_shortcut(b, i, z, k[0]));
+			count[0] = _mm256_blendv_pd(count[0],
+					_mm256_set1_pd(b->max_iter), sq[0]);
+			m[0] = _mm256_andnot_pd(sq[0], m[0]);
+			m[1] = _mm256_andnot_pd(sq[0], m[1]);
+			if (k[0] == k[1])
+			{
+				z[2] = z[0];
+				z[3] = z[1];
+				k[1] *= 2;
+			}
+		}
+	}
+	_mm256_storeu_pd(b->zr + i, z[0]);
+	_mm256_storeu_pd(b->zi + i, z[1]);
+	_mm_storeu_si128((__m128i *)(b->iter + i), _mm256_cvtpd_epi32(count[0]));
+	_mm_storeu_si128((__m128i *)(b->steps + i), _mm256_cvtpd_epi32(count[1]));
+}
+
+__attribute__((target("avx512f")))
+static __mmask8	avx512_shortcut(t_batch *b, int i, __m512d z[4], int k)
+{
+	__m512d		x;
+	__m512d		y2;
+	__m512d		q;
+	__mmask8	in;
+
+	if (k == 0)
+	{
+		x = _mm512_sub_pd(_mm512_loadu_pd(b->cr + i), _mm512_set1_pd(0.25));
+		y2 = _mm512_mul_pd(_mm512_loadu_pd(b->ci + i),
+				_mm512_loadu_pd(b->ci + i));
+		q = _mm512_add_pd(_mm512_mul_pd(x, x), y2);
+		in = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, x)),
+				_mm512_mul_pd(_mm512_set1_pd(0.25), y2), _CMP_LE_OQ);
+		x = _mm512_add_pd(_mm512_loadu_pd(b->cr + i), _mm512_set1_pd(1.0));
+		return (in | _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(x, x),
+					y2), _mm512_set1_pd(0.0625), _CMP_LE_OQ));
+	}
+	x = _mm512_abs_pd(_mm512_sub_pd(z[0], z[2]));
+	q = _mm512_abs_pd(_mm512_sub_pd(z[1], z[3]));
+	return (_mm512_cmp_pd_mask(x, _mm512_set1_pd(PERIOD_EPS), _CMP_LT_OQ)
+		& _mm512_cmp_pd_mask(q, _mm512_set1_pd(PERIOD_EPS), _CMP_LT_OQ));
+}
+
+/*
+** mask[0] marks the lanes still counted, mask[1] the lanes still stepped.
+*/
+__attribute__((target("avx512f"), always_inline))
+static inline void	avx512_group(t_batch *b, int i, int smooth)
+{
+	__m512d		z[4];
+	__m512d		sq[3];
+	__m512d		count[2];
+	__mmask8	mask[3];
+	int			k[2];
+
+	z[0] = _mm512_loadu_pd(b->zr + i);
+	z[1] = _mm512_loadu_pd(b->zi + i);
+	z[2] = z[0];
+	z[3] = z[1];
+	mask[0] = 0xFF;
+	count[0] = _mm512_setzero_pd();
+	if (b->flags & SHORTCUT_BULBS)
+	{
+		mask[2] = avx512_shortcut(b, i, z, 0);
+		mask[0] &= ~mask[2];
+		count[0] = _mm512_mask_mov_pd(count[0], mask[2],
+				_mm512_set1_pd(b->max_iter));
+	}
+	mask[1] = mask[0];
+	count[1] = _mm512_setzero_pd();
+	k[0] = 0;
+	k[1] = PERIOD_FIRST;
+	while (k[0] < b->max_iter)
+	{
+		sq[0] = _mm512_mul_pd(z[0], z[0]);
+		sq[1] = _mm512_mul_pd(z[1], z[1]);
+		sq[2] = _mm512_add_pd(sq[0], sq[1]);
+		mask[0] = _mm512_mask_cmp_pd_mask(mask[0], sq[2],
+				_mm512_set1_pd(4.0), _CMP_LE_OQ);
+		if (smooth)
+			mask[1] = _mm512_mask_cmp_pd_mask(mask[1], sq[2],
+					_mm512_set1_pd(SMOOTH_BAILOUT), _CMP_LE_OQ);
+		else
+			mask[1] = mask[0];
+		if (mask[1] == 0)
+			break ;
+		sq[1] = _mm512_sub_pd(sq[0], sq[1]);
+		sq[0] = _mm512_mul_pd(_mm512_add_pd(z[0], z[0]), z[1]);
+		z[0] = _mm512_mask_add_pd(z[0], mask[1], sq[1],
+				_mm512_loadu_pd(b->cr + i));
+		z[1] = _mm512_mask_add_pd(z[1], mask[1], sq[0],
+				_mm512_loadu_pd(b->ci + i));
+		count[0] = _mm512_mask_add_pd(count[0], mask[0], count[0],
+				_mm512_set1_pd(1.0));
+		if (smooth)
+			count[1] = _mm512_mask_add_pd(count[1], mask[1], count[1],
+					_mm512_set1_pd(1.0));
+		k[0]++;
+		if (b->flags & SHORTCUT_PERIOD)
+		{
+			mask[2] = mask[0] & avx512_shortcut(b, i, z, k[0]);
+			count[0] = _mm512_mask_mov_pd(count[0], mask[2],
+					_mm512_set1_pd(b->max_iter));
+			mask[0] &= ~mask[2];
+			mask[1] &= ~mask[2];
+			if (k[0] == k[1])
+			{
+				z[2] = z[0];
+				z[3] = z[1];
+				k[1] *= 2;
+			}
+		}
+	}
+	_mm512_storeu_pd(b->zr + i, z[0]);
+	_mm512_storeu_pd(b->zi + i, z[1]);
+	_mm256_storeu_si256((__m256i *)(b->iter + i),
+		_mm512_cvtpd_epi32(count[0]));
+	_mm256_storeu_si256((__m256i *)(b->steps + i),
+		_mm512_cvtpd_epi32(count[1]));
+}
+
+/*
+** Every group is inlined twice, so the smooth test folds away and plain
+** rendering does not pay for the second mask.
+*/
+#define SPECIALIZE(GROUP, TARGET) \
+__attribute__((target(TARGET))) \
+static void	GROUP##_plain(t_batch *b, int i) \
+{ \
+	GROUP(b, i, 0); \
+} \
+ \
+__attribute__((target(TARGET))) \
+static void	GROUP##_smooth(t_batch *b, int i) \
+{ \
+	GROUP(b, i, 1); \
+}
+
+SPECIALIZE(sse2_group, "sse2")
+SPECIALIZE(avx2_group, "avx2")
+SPECIALIZE(avx512_group, "avx512f")
+
+/*
+** Lanes past b->n are padded with a point that is already outside both
+** bailout circles, so they drop out on the first test and never hold a
+** group back.
+*/
+static void	run_groups(t_batch *b, void (*group)(t_batch *, int), int lanes)
+{
+	int	i;
+
+	i = b->n;
+	while (i % lanes)
+	{
+		b->zr[i] = 1024.0;
+		b->zi[i] = 0.0;
+		b->cr[i] = 1024.0;
+		b->ci[i] = 0.0;
+		i++;
+	}
+	i = 0;
+	while (i < b->n)
+	{
+		group(b, i);
+		i += lanes;
+	}
+}
+
+void	iterate_sse2(t_batch *b)
+{
+	if (b->flags & SMOOTH_COUNT)
+		run_groups(b, sse2_group_smooth, 2);
+	else
+		run_groups(b, sse2_group_plain, 2);
+}
+
+void	iterate_avx2(t_batch *b)
+{
+	if (b->flags & SMOOTH_COUNT)
+		run_groups(b, avx2_group_smooth, 4);
+	else
+		run_groups(b, avx2_group_plain, 4);
+}
+
+void	iterate_avx512(t_batch *b)
+{
+	if (b->flags & SMOOTH_COUNT)
+		run_groups(b, avx512_group_smooth, 8);
+	else
+		run_groups(b, avx512_group_plain, 8);
+}
+
+#endif
@@ -0,0 +1,197 @@
+#include "fract.h"
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+#endif
+
+/*
+** Float and long double variants of the kernels in kernels.c. Every
+** variant is stamped out of one of the two bodies below, so the recurrence,
+** the cardioid/bulb and cycle shortcuts and the counting are the same for
+** every element type and vector width; only the rounding differs.
+*/
+
+#define SCALAR_KERNEL(NAME, REAL, EPS) \
+void	NAME(t_batch *b) \
+{ \
+	REAL	z[4]; \
+	REAL	tmp; \
+	int		check; \
+	int		i; \
+ \
+	i = -1; \
+	while (++i < b->n) \
+	{ \
+		z[0] = b->zr[i]; \
+		z[1] = b->zi[i]; \
+		z[2] = z[0]; \
+		z[3] = z[1]; \
+		b->iter[i] = 0; \
+		if ((b->flags & SHORTCUT_BULBS) && in_bulbs(b->cr[i], b->ci[i])) \
+			b->iter[i] = b->max_iter; \
+		check = PERIOD_FIRST; \
+		while (z[0] * z[0] + z[1] * z[1] <= 4 && b->iter[i] < b->max_iter) \
+		{ \
+			tmp = z[0] * z[0] - z[1] * z[1] + (REAL)b->cr[i]; \
+			z[1] = 2 * z[0] * z[1] + (REAL)b->ci[i]; \
+			z[0] = tmp; \
+			b->iter[i]++; \
+			if ((b->flags & SHORTCUT_PERIOD) && z[0] - z[2] < EPS \
+				&& z[2] - z[0] < EPS && z[1] - z[3] < EPS \
+				&& z[3] - z[1] < EPS) \
+				b->iter[i] = b->max_iter; \
+			else if ((b->flags & SHORTCUT_PERIOD) && b->iter[i] == check) \
+			{ \
+				z[2] = z[0]; \
+				z[3] = z[1]; \
+				check *= 2; \
+			} \
+		} \
+		b->steps[i] = b->iter[i]; \
+		while ((b->flags & SMOOTH_COUNT) && b->iter[i] < b->max_iter \
+			&& b->steps[i] < b->max_iter \
+			&& z[0] * z[0] + z[1] * z[1] <= SMOOTH_BAILOUT) \
+		{ \
+			tmp = z[0] * z[0] - z[1] * z[1] + (REAL)b->cr[i]; \
+			z[1] = 2 * z[0] * z[1] + (REAL)b->ci[i]; \
+			z[0] = tmp; \
+			b->steps[i]++; \
+		} \
+		b->zr[i] = z[0]; \
+		b->zi[i] = z[1]; \
+	} \
+}
+
+/*
+** GCC vector extensions carry the float arithmetic, so one body serves
+** every width; ANY(m) is the width's "some lane still active" test.
+** Lanes keep their z and counts through bitwise selects once they stop:
+** m[0] marks the lanes still counted, m[1] those still stepped towards
+** the smoothing bailout. Lanes past b->n start escaped.
+*/
+#define VECTOR_KERNEL(NAME, LANES, TARGET, ANY) \
+typedef float	t_##NAME##_f __attribute__((vector_size(4 * LANES))); \
+typedef int		t_##NAME##_i __attribute__((vector_size(4 * LANES))); \
+ \
+__attribute__((target(TARGET))) \
+static t_##NAME##_i	NAME##_load(t_batch *b, int i, t_##NAME##_f z[6], \
+		t_##NAME##_i *count) \
+{ \
+	t_##NAME##_i	active; \
+	int				k; \
+ \
+	z[1] = (t_##NAME##_f){0}; \
+	z[0] = z[1] + 1024.0f; \
+	z[4] = z[0]; \
+	z[5] = z[1]; \
+	*count = (t_##NAME##_i){0}; \
+	active = *count - 1; \
+	k = -1; \
+	while (++k < LANES && i + k < b->n) \
+	{ \
+		z[0][k] = b->zr[i + k]; \
+		z[1][k] = b->zi[i + k]; \
+		z[4][k] = b->cr[i + k]; \
+		z[5][k] = b->ci[i + k]; \
+		if ((b->flags & SHORTCUT_BULBS) \
+			&& in_bulbs(b->cr[i + k], b->ci[i + k])) \
+		{ \
+			(*count)[k] = b->max_iter; \
+			active[k] = 0; \
+		} \
+	} \
+	z[2] = z[0]; \
+	z[3] = z[1]; \
+	return (active); \
+} \
+ \
+__attribute__((target(TARGET), always_inline)) \
+static inline void	NAME##_group(t_batch *b, int i, int smooth) \
+{ \
+	t_##NAME##_f	z[6]; \
+	t_##NAME##_f	t; \
+	t_##NAME##_i	m[3]; \
+	t_##NAME##_i	count[2]; \
+	int				k[2]; \
+ \
+	m[0] = NAME##_load(b, i, z, count); \
+	m[1] = m[0]; \
+	count[1] = count[0] & 0; \
+	k[0] = 0; \
+	k[1] = PERIOD_FIRST; \
+	while (k[0] < b->max_iter) \
+	{ \
+		t = z[0] * z[0] + z[1] * z[1]; \
+		m[0] &= t <= 4.0f; \
+		m[1] &= t <= (float)SMOOTH_BAILOUT; \
+		if (!smooth) \
+			m[1] = m[0]; \
+		if (!ANY(m[1])) \
+			break ; \
+		t = z[0] * z[0] - z[1] * z[1] + z[4]; \
+		z[1] = (t_##NAME##_f)(((t_##NAME##_i)(2 * z[0] * z[1] + z[5]) \
+					& m[1]) | ((t_##NAME##_i)z[1] & ~m[1])); \
+		z[0] = (t_##NAME##_f)(((t_##NAME##_i)t & m[1]) \
+				| ((t_##NAME##_i)z[0] & ~m[1])); \
+		count[0] -= m[0]; \
+		if (smooth) \
+			count[1] -= m[1]; \
+		k[0]++; \
+		if (b->flags & SHORTCUT_PERIOD) \
+		{ \
+			m[2] = m[0] & (z[0] - z[2] < PERIOD_EPS_F) \
+				& (z[2] - z[0] < PERIOD_EPS_F) \
+				& (z[1] - z[3] < PERIOD_EPS_F) \
+				& (z[3] - z[1] < PERIOD_EPS_F); \
+			count[0] = (count[0] & ~m[2]) | (b->max_iter & m[2]); \
+			m[0] &= ~m[2]; \
+			m[1] &= ~m[2]; \
+			if (k[0] == k[1]) \
+			{ \
+				z[2] = z[0]; \
+				z[3] = z[1]; \
+				k[1] *= 2; \
+			} \
+		} \
+	} \
+	k[0] = -1; \
+	while (++k[0] < LANES && i + k[0] < b->n) \
+	{ \
+		b->iter[i + k[0]] = count[0][k[0]]; \
+		b->steps[i + k[0]] = count[1][k[0]]; \
+		b->zr[i + k[0]] = z[0][k[0]]; \
+		b->zi[i + k[0]] = z[1][k[0]]; \
+	} \
+} \
+ \
+__attribute__((target(TARGET))) \
+void	NAME(t_batch *b) \
+{ \
+	int	i; \
+ \
+	i = 0; \
+	while (i < b->n && (b->flags & SMOOTH_COUNT)) \
+	{ \
+		NAME##_group(b, i, 1); \
+		i += LANES; \
+	} \
+	while (i < b->n) \
+	{ \
+		NAME##_group(b, i, 0); \
+		i += LANES; \
+	} \
+}
+
+SCALAR_KERNEL(iterate_float, float, PERIOD_EPS_F)
+SCALAR_KERNEL(iterate_long, long double, PERIOD_EPS_L)
+
+#if defined(__x86_64__) || defined(__i386__)
+
+# define SSE2_ANY(m) _mm_movemask_ps((__m128)(m))
+# define AVX2_ANY(m) _mm256_movemask_ps((__m256)(m))
+# define AVX512_ANY(m) _mm512_test_epi32_mask((__m512i)(m), (__m512i)(m))
+
+VECTOR_KERNEL(iterate_sse2_f32, 4, "sse2", SSE2_ANY)
+VECTOR_KERNEL(iterate_avx2_f32, 8, "avx2", AVX2_ANY)
+VECTOR_KERNEL(iterate_avx512_f32, 16, "avx512f", AVX512_ANY)
+
+#endif
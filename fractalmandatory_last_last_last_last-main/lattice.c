@@ -0,0 +1,146 @@
+#include "fract.h"
+#include <math.h>
+
+/*
+** The tile cache and store only work if a lattice point gets the same
+** coordinates in every view that shows it. Pixel spacings are therefore kept
+** to doubles with a 4 bit mantissa, 8/8 .. 15/8 times a power of two, and the
+** view corner to a whole multiple of the spacing: min_re + x * spacing is
+** then exact, whatever the corner. The eight spacings of an octave step by
+** 1.07 to 1.13, about the mouse wheel's old 0.9 / 1.1.
+**
+** Returns the spacing `step` levels above the one nearest to `spacing`.
+*/
+double	lattice_spacing(double spacing, int step)
+{
+	double	m;
+	int		e;
+	long	q;
+
+	m = frexp(spacing, &e);
+	q = lround(m * 16.0);
+	if (q == 16)
+	{
+		q = 8;
+		e++;
+	}
+	q += step;
+	while (q < 8)
+	{
+		q += 8;
+		e--;
+	}
+	while (q > 15)
+	{
+		q -= 8;
+		e++;
+	}
+	return (ldexp((double)q, e - 4));
+}
+
+static int	snappable(t_fractal *fract)
+{
+	return ((fract->cache.table || fract->store.map) && !fract->deep.based
+		&& fract->factors[0] >= DEEP_SPACING);
+}
+
+/*
+** Mouse wheel zoom factor: one level in or out when the view is on the
+** lattice, `zoom` itself otherwise.
+*/
+double	lattice_zoom(t_fractal *fract, double zoom)
+{
+	update_factors(fract);
+	if (!snappable(fract))
+		return (zoom);
+	if (zoom < 1.0)
+		return (lattice_spacing(fract->factors[0], -1) / fract->factors[0]);
+	return (lattice_spacing(fract->factors[0], 1) / fract->factors[0]);
+}
+
+/*
+** Moves the view onto the nearest lattice level and corner, by less than
+** half a pixel, keeping its center.
+*/
+void	snap_view(t_fractal *fract)
+{
+	double	spacing;
+	double	o[2];
+
+	update_factors(fract);
+	if (!snappable(fract))
+		return ;
+	spacing = lattice_spacing(fract->factors[0], 0);
+	o[0] = nearbyint((fract->min_re + fract->max_re) / 2.0 / spacing
+			- (fract->width - 1) / 2.0);
+	o[1] = nearbyint(-(fract->min_im + fract->max_im) / 2.0 / spacing
+			- (fract->height - 1) / 2.0);
+	if (fabs(o[0]) > LATTICE_MAX || fabs(o[1]) > LATTICE_MAX)
+		return ;
+	fract->min_re = o[0] * spacing;
+	fract->max_re = fract->min_re + (fract->width - 1) * spacing;
+	fract->max_im = -o[1] * spacing;
+	fract->min_im = fract->max_im - (fract->height - 1) * spacing;
+}
+
+/*
+** Decides whether the current pass can use the cache, which only holds
+** full resolution tiles, and if so where the view sits on the lattice:
+** lattice[] is the lattice index of pixel (0, 0), counted right and down.
+** The tiles of the region are then aligned to the lattice tiles,
+** tile_shift[] pixels before the region's corner, so every tile job covers
+** part of exactly one cached tile.
+*/
+void	lattice_update(t_fractal *fract)
+{
+	double	o[2];
+
+	fract->cached = 0;
+	fract->tile_shift[0] = 0;
+	fract->tile_shift[1] = 0;
+	if ((!fract->cache.table && !fract->store.map) || fract->step != 1
+		|| fract->deep.active || fract->deep.based
+		|| fract->factors[0] != fract->factors[1]
+		|| fract->factors[0] != lattice_spacing(fract->factors[0], 0))
+		return ;
+	o[0] = fract->min_re / fract->factors[0];
+	o[1] = -fract->max_im / fract->factors[0];
+	if (o[0] != nearbyint(o[0]) || o[1] != nearbyint(o[1])
+		|| fabs(o[0]) > LATTICE_MAX || fabs(o[1]) > LATTICE_MAX)
+		return ;
+	fract->cached = 1;
+	fract->lattice[0] = (long)o[0];
+	fract->lattice[1] = (long)o[1];
+	fract->tile_shift[0] = ((fract->lattice[0] + fract->region[0])
+			% TILE_SIZE + TILE_SIZE) % TILE_SIZE;
+	fract->tile_shift[1] = ((fract->lattice[1] + fract->region[1])
+			% TILE_SIZE + TILE_SIZE) % TILE_SIZE;
+}
+
+/*
+** Whether the cache holds every tile of the full view, in which case
+** render_fractal() skips the preview passes.
+*/
+int	cache_covers(t_fractal *fract)
+{
+	int	rect[4];
+	int	tiles;
+	int	tile;
+
+	fract->step = 1;
+	fract->region[0] = 0;
+	fract->region[1] = 0;
+	fract->region[2] = fract->width;
+	fract->region[3] = fract->height;
+	tiles = prepare_region(fract);
+	if (!fract->cached)
+		return (0);
+	tile = 0;
+	while (tile < tiles)
+	{
+		tile_rect(fract, tile++, rect);
+		if (!cache_has(fract, rect))
+			return (0);
+	}
+	return (1);
+}
@@ -0,0 +1,201 @@
+#include "fract.h"
+
+static int	option_error(const char *arg)
+{
+	printf("Error: Invalid option '%s'\n\n", arg);
+	print_usage();
+	return (1);
+}
+
+static int	parse_int(const char **s, int min, int max)
+{
+	double	value;
+
+	if (**s < '0' || **s > '9')
+		return (-1);
+	value = is_it_int(s);
+	if (value < min || value > max)
+		return (-1);
+	return ((int)value);
+}
+
+/*
+** Pixel, byte and anti-aliasing sample offsets are ints, so an image holds
+** at most MAX_PIXELS pixels, INT_MAX / AA_SAMPLES.
+*/
+static int	parse_size(const char *s, t_fractal *fract)
+{
+	fract->width = parse_int(&s, 2, MAX_SIZE);
+	if (fract->width < 0 || *s++ != 'x')
+		return (1);
+	fract->height = parse_int(&s, 2, MAX_SIZE);
+	if (fract->height < 0 || *s != '\0')
+		return (1);
+	return ((long)fract->width * fract->height > MAX_PIXELS);
+}
+
+/*
+** `--iter N` pins max_iter, `--iter auto` leaves it to tune_iter().
+*/
+static int	parse_iter(const char *s, t_fractal *fract)
+{
+	fract->tuning.auto_iter = ft_strcmp(s, "auto") == 0;
+	if (fract->tuning.auto_iter)
+		return (0);
+	fract->max_iter = parse_int(&s, 1, 1000000000);
+	return (fract->max_iter < 0 || *s != '\0');
+}
+
+static int	parse_precision(const char *s, t_fractal *fract)
+{
+	if (ft_strcmp(s, "auto") == 0)
+		fract->precision = PREC_AUTO;
+	else if (ft_strcmp(s, "float") == 0)
+		fract->precision = PREC_FLOAT;
+	else if (ft_strcmp(s, "double") == 0)
+		fract->precision = PREC_DOUBLE;
+	else if (ft_strcmp(s, "long") == 0)
+		fract->precision = PREC_LONG;
+	else
+		return (1);
+	return (0);
+}
+
+static int	parse_palette(const char *s, t_fractal *fract)
+{
+	static const char	*names[NUM_PALETTES] = {"default", "fire", "ocean",
+		"psychedelic", "grayscale", "rainbow"};
+	int					i;
+
+	i = 0;
+	while (i < NUM_PALETTES && ft_strcmp(s, names[i]) != 0)
+		i++;
+	fract->palette = i;
+	return (i == NUM_PALETTES);
+}
+
+static int	parse_one(char **argv, int *i, int left, t_options *opt)
+{
+	const char	*s;
+
+	if (ft_strcmp(argv[*i], "--center") == 0 && left > 2)
+	{
+		opt->center_text[0] = argv[++(*i)];
+		opt->center_text[1] = argv[++(*i)];
+		opt->center[0] = ft_atof(opt->center_text[0]);
+		opt->center[1] = ft_atof(opt->center_text[1]);
+	}
+	else if (ft_strcmp(argv[*i], "--span") == 0 && left > 1)
+	{
+		opt->span = ft_atof(argv[++(*i)]);
+		if (opt->span <= 0.0)
+			return (1);
+	}
+	else if (ft_strcmp(argv[*i], "--out") == 0 && left > 1)
+		opt->out = argv[++(*i)];
+	else if (ft_strcmp(argv[*i], "--store") == 0 && left > 1)
+		opt->store = argv[++(*i)];
+	else if (ft_strcmp(argv[*i], "--port") == 0 && left > 1)
+	{
+		s = argv[++(*i)];
+		opt->port = parse_int(&s, 1, 65535);
+		if (opt->port < 0 || *s != '\0')
+			return (1);
+	}
+	else if (ft_strcmp(argv[*i], "--budget") == 0 && left > 1)
+	{
+		s = argv[++(*i)];
+		opt->budget = parse_int(&s, 0, 60000);
+		if (opt->budget < 0 || *s != '\0')
+			return (1);
+	}
+	else if (ft_strcmp(argv[*i], "--power") == 0 && left > 1)
+	{
+		s = argv[++(*i)];
+		opt->power = parse_int(&s, 2, MAX_POWER);
+		if (opt->power < 0 || *s != '\0')
+			return (1);
+	}
+	else if (ft_strcmp(argv[*i], "--levels") == 0 && left > 1)
+	{
+		s = argv[++(*i)];
+		opt->levels = parse_int(&s, 1, STORE_LEVELS);
+		if (opt->levels < 0 || *s != '\0')
+			return (1);
+	}
+	else
+		return (1);
+	return (0);
+}
+
+/*
+** Parses the trailing `--flag value` options shared by the window and the
+** headless renderer. The view defaults to whatever init_fractal() set up, so
+** a caller that only passes --size keeps the same framing.
+*/
+int	parse_options(int argc, char **argv, t_fractal *fract, t_options *opt)
+{
+	const char	*s;
+	int			i;
+	int			mb;
+
+	opt->out = NULL;
+	opt->store = NULL;
+	opt->levels = 1;
+	opt->budget = 0;
+	opt->power = 0;
+	opt->port = SERVE_PORT;
+	opt->center_text[0] = NULL;
+	opt->center_text[1] = NULL;
+	opt->center[0] = (fract->min_re + fract->max_re) / 2.0;
+	opt->center[1] = (fract->min_im + fract->max_im) / 2.0;
+	opt->span = fract->max_re - fract->min_re;
+	i = 0;
+	while (i < argc)
+	{
+		if (ft_strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+		{
+			if (parse_size(argv[++i], fract))
+				return (option_error(argv[i]));
+		}
+		else if (ft_strcmp(argv[i], "--iter") == 0 && i + 1 < argc)
+		{
+			if (parse_iter(argv[++i], fract))
+				return (option_error(argv[i]));
+		}
+		else if (ft_strcmp(argv[i], "--precision") == 0 && i + 1 < argc)
+		{
+			if (parse_precision(argv[++i], fract))
+				return (option_error(argv[i]));
+		}
+		else if (ft_strcmp(argv[i], "--palette") == 0 && i + 1 < argc)
+		{
+			if (parse_palette(argv[++i], fract))
+				return (option_error(argv[i]));
+		}
+		else if (ft_strcmp(argv[i], "--shift") == 0 && i + 1 < argc)
+			fract->color_shift = ft_atof(argv[++i]);
+		else if (ft_strcmp(argv[i], "--smooth") == 0)
+			fract->smooth = 1;
+		else if (ft_strcmp(argv[i], "--stats") == 0)
+			fract->report = 1;
+		else if (ft_strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+		{
+			s = argv[++i];
+			mb = parse_int(&s, 0, 1000000);
+			if (mb < 0 || *s != '\0')
+				return (option_error(argv[i]));
+			fract->cache.cap = (size_t)mb << 20;
+		}
+		else if (ft_strcmp(argv[i], "--aa") == 0)
+			fract->aa.on = 1;
+		else if (ft_strcmp(argv[i], "--exact") == 0)
+			fract->shortcuts = 0;
+		else if (ft_strcmp(argv[i], "--subdivide") == 0)
+			fract->subdivide = 1;
+		else if (parse_one(argv, &i, argc - i, opt))
+			return (option_error(argv[i]));
+		i++;
+	}
+	return (0);
+}
@@ -0,0 +1,137 @@
+#include "fract.h"
+#include <math.h>
+#include <stdlib.h>
+
+static int	rgb(double r, double g, double b)
+{
+	return (((int)(r * 255) << 16) | ((int)(g * 255) << 8) | (int)(b * 255));
+}
+
+/*
+** h in degrees, s and v in [0, 1].
+*/
+int	hsv_to_rgb(double h, double s, double v)
+{
+	double	p[3];
+	int		sector;
+
+	h = fmod(h, 360.0) / 60.0;
+	if (h < 0.0)
+		h += 6.0;
+	sector = (int)h % 6;
+	p[0] = v * (1.0 - s);
+	p[1] = v * (1.0 - s * (h - (int)h));
+	p[2] = v * (1.0 - s * (1.0 - (h - (int)h)));
+	if (sector == 0)
+		return (rgb(v, p[2], p[0]));
+	if (sector == 1)
+		return (rgb(p[1], v, p[0]));
+	if (sector == 2)
+		return (rgb(p[0], v, p[2]));
+	if (sector == 3)
+		return (rgb(p[0], p[1], v));
+	if (sector == 4)
+		return (rgb(p[2], p[0], v));
+	return (rgb(v, p[0], p[1]));
+}
+
+/*
+** Color of an escaped point at t = iter / max_iter in [0, 1). The default
+** palette is the original Bernstein polynomial gradient.
+*/
+static int	palette_color(t_color_palette palette, double t)
+{
+	if (palette == PALETTE_FIRE)
+		return (rgb(fmin(3.0 * t, 1.0), fmin(fmax(3.0 * t - 1.0, 0.0), 1.0),
+				fmax(3.0 * t - 2.0, 0.0)));
+	if (palette == PALETTE_OCEAN)
+		return (rgb(t * t * t, t * t, 0.5 + 0.5 * t));
+	if (palette == PALETTE_PSYCHEDELIC)
+		return (hsv_to_rgb(360.0 * 8.0 * t, 1.0, 1.0));
+	if (palette == PALETTE_GRAYSCALE)
+		return (rgb(t, t, t));
+	if (palette == PALETTE_RAINBOW)
+		return (hsv_to_rgb(360.0 * t, 0.8, 1.0));
+	return (((int)(9 * (1 - t) * t * t * t * 255) << 16)
+		| ((int)(15 * (1 - t) * (1 - t) * t * t * 255) << 8)
+		| (int)(8.5 * (1 - t) * (1 - t) * (1 - t) * t * 255));
+}
+
+/*
+** Bakes the palette for max_iter into two back to back copies, so the
+** cycle shift is an index offset and a lookup never wraps. The table is
+** only rebuilt when the palette or max_iter change; a new color_shift just
+** moves the offset. Past PALETTE_LUT_MAX, or when the allocation fails,
+** get_color() evaluates the palette directly.
+*/
+void	palette_update(t_fractal *fract)
+{
+	t_palette	*p;
+	int			i;
+
+	p = &fract->colors;
+	p->offset = (int)((fract->color_shift - floor(fract->color_shift))
+			* fract->max_iter) % fract->max_iter;
+	if (p->size == fract->max_iter && p->type == fract->palette)
+		return ;
+	palette_free(p);
+	p->size = fract->max_iter;
+	p->type = fract->palette;
+	if (p->size > PALETTE_LUT_MAX)
+		return ;
+	p->lut = malloc(2 * (size_t)p->size * sizeof(int));
+	if (!p->lut)
+		return ;
+	i = -1;
+	while (++i < p->size)
+		p->lut[i] = palette_color(p->type, (double)i / p->size);
+	while (i < 2 * p->size)
+	{
+		p->lut[i] = p->lut[i - p->size];
+		i++;
+	}
+}
+
+int	get_color(const t_palette *p, int iter)
+{
+	if (iter >= p->size)
+		return (0x000000);
+	if (p->lut)
+		return (p->lut[iter + p->offset]);
+	return (palette_color(p->type,
+			(double)((iter + (long)p->offset) % p->size) / p->size));
+}
+
+/*
+** Blends the colors of the two counts around `smooth`.
+*/
+int	get_smooth_color(const t_palette *p, int iter, float smooth)
+{
+	double	t;
+	int		c[2];
+	int		mix;
+	int		shift;
+
+	if (iter >= p->size)
+		return (0x000000);
+	t = fmin(fmax(smooth, 0.0), p->size - 1);
+	c[0] = get_color(p, (int)t);
+	c[1] = get_color(p, ((int)t + 1) % p->size);
+	t -= (int)t;
+	mix = 0;
+	shift = 0;
+	while (shift <= 16)
+	{
+		mix |= (((c[0] >> shift) & 255) + (int)(t * (((c[1] >> shift) & 255)
+						- ((c[0] >> shift) & 255)))) << shift;
+		shift += 8;
+	}
+	return (mix);
+}
+
+void	palette_free(t_palette *p)
+{
+	free(p->lut);
+	p->lut = NULL;
+	p->size = 0;
+}
@@ -0,0 +1,127 @@
+#include "fract.h"
+
+/*
+** Starting deviation after the skipped iterations, from the series in
+** b->deep: dz = ((c u + b) u + a) u with u = delta / radius.
+*/
+static void	series_start(const t_deep *d, const double delta[2], double dz[2])
+{
+	const double	*s;
+	double			u[2];
+	double			t;
+
+	s = d->series;
+	u[0] = delta[0] / d->radius;
+	u[1] = delta[1] / d->radius;
+	dz[0] = s[4] * u[0] - s[5] * u[1] + s[2];
+	dz[1] = s[4] * u[1] + s[5] * u[0] + s[3];
+	t = dz[0] * u[0] - dz[1] * u[1] + s[0];
+	dz[1] = dz[0] * u[1] + dz[1] * u[0] + s[1];
+	dz[0] = t * u[0] - dz[1] * u[1];
+	dz[1] = t * u[1] + dz[1] * u[0];
+}
+
+/*
+** Where the pixel's orbit starts: after the iterations the series skips,
+** or with RESUME_ORBIT from the z it stopped at, rebased onto the start
+** of the critical-point orbit like a glitch. Returns the index into the
+** reference orbit.
+*/
+static int	orbit_start(t_batch *b, int i, double dz[2], double dc[2])
+{
+	dc[0] = b->cr[i];
+	dc[1] = b->ci[i];
+	if (b->deep->julia)
+	{
+		dc[0] = b->zr[i];
+		dc[1] = b->zi[i];
+	}
+	if (b->flags & RESUME_ORBIT)
+	{
+		dz[0] = b->zr[i];
+		dz[1] = b->zi[i];
+	}
+	else
+		series_start(b->deep, dc, dz);
+	if (b->deep->julia)
+	{
+		dc[0] = 0.0;
+		dc[1] = 0.0;
+	}
+	if (b->flags & RESUME_ORBIT)
+		return (0);
+	return (b->deep->skip);
+}
+
+/*
+** Iterates dz' = (2Z + dz) dz + dc against the reference orbit Z, with
+** z = Z + dz tested for escape exactly like the direct kernels. When |z|
+** drops below |dz|, or the reference runs out, precision would be lost
+** (a glitch), so the pixel is rebased: dz becomes z itself and iteration
+** continues from the start of the critical-point orbit, where Z_0 = 0.
+** With SMOOTH_COUNT the orbit goes on to the larger bailout and the count
+** is the step at which |z|^2 first passed 4.
+*/
+static void	perturb_point(t_batch *b, int i, const t_deep *d, double bail)
+{
+	const t_orbit	*o;
+	double			dc[2];
+	double			dz[2];
+	double			z[2];
+	int				m;
+
+	m = orbit_start(b, i, dz, dc);
+	o = d->orbit;
+	if (b->flags & RESUME_ORBIT)
+		o = d->orbit + d->julia;
+	b->iter[i] = -1;
+	b->steps[i] = m;
+	z[0] = o->zr[m] + dz[0];
+	z[1] = o->zi[m] + dz[1];
+	while (z[0] * z[0] + z[1] * z[1] <= bail && b->steps[i] < b->max_iter)
+	{
+		if (b->iter[i] < 0 && z[0] * z[0] + z[1] * z[1] > 4.0)
+			b->iter[i] = b->steps[i];
+		z[0] = (2.0 * o->zr[m] + dz[0]) * dz[0]
+			- (2.0 * o->zi[m] + dz[1]) * dz[1] + dc[0];
+		dz[1] = (2.0 * o->zr[m] + dz[0]) * dz[1]
+			+ (2.0 * o->zi[m] + dz[1]) * dz[0] + dc[1];
+		dz[0] = z[0];
+		m++;
+		b->steps[i]++;
+		z[0] = o->zr[m] + dz[0];
+		z[1] = o->zi[m] + dz[1];
+		if (m == o->len - 1 || z[0] * z[0] + z[1] * z[1]
+			< dz[0] * dz[0] + dz[1] * dz[1])
+		{
+			dz[0] = z[0];
+			dz[1] = z[1];
+			o = d->orbit + d->julia;
+			m = 0;
+		}
+	}
+	if (b->iter[i] < 0)
+		b->iter[i] = b->steps[i];
+	b->zr[i] = z[0];
+	b->zi[i] = z[1];
+}
+
+/*
+** Deep zoom kernel: b->cr/ci (Mandelbrot) or b->zr/zi (Julia) hold the
+** pixel's offset from the deep origin rather than its absolute position.
+*/
+void	iterate_perturb(t_batch *b)
+{
+	double	bail;
+	int		i;
+
+	bail = 4.0;
+	if (b->flags & SMOOTH_COUNT)
+		bail = SMOOTH_BAILOUT;
+	i = 0;
+	while (i < b->n)
+	{
+		perturb_point(b, i, b->deep, bail);
+		i++;
+	}
+}
@@ -0,0 +1,227 @@
+#include "fract.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+** Level i lies i lattice levels below `spacing`, the one --size gives the
+** view, and holds the lattice tiles that cover the view there.
+*/
+static int	plan_level(t_fractal *fract, t_store_head *h, int i,
+		double spacing)
+{
+	t_store_level	*l;
+
+	l = h->level + i;
+	l->spacing = lattice_spacing(spacing, -i);
+	if (l->spacing < DEEP_SPACING || fmax(fmax(fabs(fract->min_re),
+				fabs(fract->max_re)), fmax(fabs(fract->min_im),
+				fabs(fract->max_im))) / l->spacing > LATTICE_MAX)
+	{
+		printf("Error: Level %d is too deep for the tile store\n", i);
+		return (1);
+	}
+	l->tx = (long)floor(fract->min_re / l->spacing / TILE_SIZE);
+	l->ty = (long)floor(-fract->max_im / l->spacing / TILE_SIZE);
+	l->nx = (long)floor(fract->max_re / l->spacing / TILE_SIZE) - l->tx + 1;
+	l->ny = (long)floor(-fract->min_im / l->spacing / TILE_SIZE) - l->ty + 1;
+	l->first = h->tiles;
+	h->tiles += l->nx * l->ny;
+	fract->factors[0] = l->spacing;
+	select_precision(fract);
+	l->tier = 0;
+	while (fract->kernels[l->tier] != fract->iterate)
+		l->tier++;
+	return (0);
+}
+
+static int	plan_store(t_fractal *fract, t_store_head *h, int levels)
+{
+	double	spacing;
+	int		i;
+
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, STORE_MAGIC, sizeof(h->magic));
+	h->version = STORE_VERSION;
+	h->type = fract->type;
+	formula_params(fract, h->c);
+	h->max_iter = fract->max_iter;
+	h->flags = tile_flags(fract);
+	h->levels = levels;
+	spacing = lattice_spacing(fract->factors[0], 0);
+	i = 0;
+	while (i < levels)
+	{
+		if (plan_level(fract, h, i++, spacing))
+			return (1);
+	}
+	return (0);
+}
+
+/*
+** Creates the store file, or maps an existing one to resume it: tiles
+** whose done byte is set are kept, so an interrupted run picks up where it
+** stopped. The file must have been planned for the same parameters.
+*/
+static int	open_store(t_store *store, const char *path, t_store_head *h)
+{
+	off_t	size;
+	int		fd;
+	int		status;
+
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		printf("Error: Cannot write '%s'\n", path);
+		return (1);
+	}
+	size = lseek(fd, 0, SEEK_END);
+	status = size < 0 || (size && (size_t)size != store_size(h))
+		|| (!size && ftruncate(fd, (off_t)store_size(h)));
+	if (status)
+		printf("Error: Cannot use '%s' as a store for this view\n", path);
+	else
+		status = store_map(store, fd, h, PROT_READ | PROT_WRITE);
+	close(fd);
+	if (status)
+		return (1);
+	if (!store->head->magic[0])
+		memcpy(store->head, h, sizeof(*h));
+	if (memcmp(store->head, h, sizeof(*h)) == 0)
+		return (0);
+	store_close(store);
+	printf("Error: '%s' holds a store with other parameters\n", path);
+	return (1);
+}
+
+/*
+** Copies the tile whose top left pixel is (x, y) out of the rendered image.
+*/
+static void	copy_tile(t_fractal *fract, t_counts *dst, int x, int y)
+{
+	int	row;
+
+	row = 0;
+	while (row < TILE_SIZE)
+	{
+		memcpy(dst->iter + row * TILE_SIZE, fract->iters
+			+ (y + row) * fract->width + x, TILE_SIZE * sizeof(int));
+		memcpy(dst->smooth + row * TILE_SIZE, fract->smooth_iters
+			+ (y + row) * fract->width + x, TILE_SIZE * sizeof(float));
+		row++;
+	}
+}
+
+/*
+** Renders the STORE_CHUNK x STORE_CHUNK tiles from pos of level l as one
+** image, unless they are all done, and stores those that are not. Returns
+** the number of tiles stored.
+*/
+static long	fill_chunk(t_fractal *fract, t_store *s, const t_store_level *l,
+		long pos[2])
+{
+	long	t[2];
+	long	i;
+	long	n;
+
+	fract->min_re = (double)((l->tx + pos[0]) * TILE_SIZE) * l->spacing;
+	fract->max_re = fract->min_re + (fract->width - 1) * l->spacing;
+	fract->max_im = -(double)((l->ty + pos[1]) * TILE_SIZE) * l->spacing;
+	fract->min_im = fract->max_im - (fract->height - 1) * l->spacing;
+	n = 0;
+	t[1] = pos[1] - 1;
+	while (++t[1] < pos[1] + STORE_CHUNK && t[1] < l->ny)
+	{
+		t[0] = pos[0] - 1;
+		while (++t[0] < pos[0] + STORE_CHUNK && t[0] < l->nx)
+		{
+			i = l->first + t[1] * l->nx + t[0];
+			if (s->done[i])
+				continue ;
+			if (n++ == 0)
+				render_image(fract);
+			copy_tile(fract, s->tiles + i, (t[0] - pos[0]) * TILE_SIZE,
+				(t[1] - pos[1]) * TILE_SIZE);
+			__atomic_store_n(s->done + i, 1, __ATOMIC_RELEASE);
+		}
+	}
+	return (n);
+}
+
+static void	fill_store(t_fractal *fract, t_store *s)
+{
+	const t_store_level	*l;
+	long				pos[2];
+	long				n;
+
+	l = s->head->level;
+	while (l < s->head->level + s->head->levels)
+	{
+		n = 0;
+		pos[1] = 0;
+		while (pos[1] < l->ny)
+		{
+			pos[0] = 0;
+			while (pos[0] < l->nx)
+			{
+				n += fill_chunk(fract, s, l, pos);
+				pos[0] += STORE_CHUNK;
+			}
+			pos[1] += STORE_CHUNK;
+		}
+		printf("Level %d: spacing %g, %ldx%ld tiles, %ld computed\n",
+			(int)(l - s->head->level), l->spacing, l->nx, l->ny, n);
+		l++;
+	}
+}
+
+/*
+** `./fractol precompute <fractal> [parameters] [options] --store <file>
+** [--levels N]`: fills a memory-mappable pyramid of full resolution tiles
+** over the view, N lattice levels deep from the spacing --size gives it,
+** for the viewer and `render` to read with --store. Rerunning the same
+** command resumes an interrupted run.
+*/
+int	precompute(int argc, char **argv)
+{
+	t_fractal		fract;
+	t_options		opt;
+	t_store_head	head;
+	t_store			store;
+	int				status;
+
+	init_fractal(&fract);
+	if (argc < 2)
+		print_usage();
+	if (argc < 2 || parse_args(argc, argv, &fract, &opt))
+		return (1);
+	if (!opt.store)
+		printf("Error: precompute requires --store <file>\n");
+	update_factors(&fract);
+	if (opt.store && fract.factors[0] >= DEEP_SPACING)
+		deep_update(&fract);
+	if (!opt.store || plan_store(&fract, &head, opt.levels)
+		|| open_store(&store, opt.store, &head))
+		return (1);
+	fract.width = STORE_CHUNK * TILE_SIZE;
+	fract.height = STORE_CHUNK * TILE_SIZE;
+	fract.aa.on = 0;
+	status = alloc_buffer(&fract);
+	if (!status)
+	{
+		pool_init(&fract);
+		fill_store(&fract, &store);
+		pool_destroy(&fract.pool);
+		status = msync(store.map, store.size, MS_SYNC) != 0;
+		free(fract.addr);
+	}
+	store_close(&store);
+	free(fract.iters);
+	free(fract.smooth_iters);
+	aa_free(&fract.aa);
+	palette_free(&fract.colors);
+	return (status);
+}
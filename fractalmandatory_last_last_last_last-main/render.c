@@ -0,0 +1,277 @@
+#include "fract.h"
+
+void	init_batch(t_fractal *fract, t_batch *b)
+{
+	b->n = 0;
+	b->max_iter = fract->max_iter;
+	b->flags = fract->shortcuts;
+	if (fract->smooth)
+		b->flags |= SMOOTH_COUNT;
+	b->flags &= fract->formula->flags;
+	b->power = fract->formula->power;
+	if (!b->power)
+		b->power = fract->power;
+	b->deep = NULL;
+	if (fract->deep.active)
+		b->deep = &fract->deep;
+}
+
+void	run_batch(t_fractal *fract, t_batch *b)
+{
+	if (b->deep)
+		iterate_perturb(b);
+	else
+		fract->iterate(b);
+	if (b->flags & SMOOTH_COUNT)
+		smooth_batch(b);
+	else if (fract->smooth)
+		plain_batch(b);
+}
+
+/*
+** Stores a sample's counts as a step x step block, or as a single pixel
+** when a reprojected preview already fills the gaps better than a block
+** would.
+*/
+void	fill_block(t_fractal *fract, int pos[2], int iter, float smooth)
+{
+	int	size;
+	int	dx;
+	int	dy;
+
+	size = 1;
+	if (fract->blocks)
+		size = fract->step;
+	dy = 0;
+	while (dy < size && pos[1] + dy < fract->height)
+	{
+		dx = 0;
+		while (dx < size && pos[0] + dx < fract->width)
+		{
+			fract->iters[(pos[1] + dy) * fract->width + pos[0] + dx] = iter;
+			if (fract->smooth)
+				fract->smooth_iters[(pos[1] + dy) * fract->width + pos[0]
+					+ dx] = smooth;
+			dx++;
+		}
+		dy++;
+	}
+}
+
+/*
+** Computes every step-th sample of row y between x and x_end and stores it
+** as a step x step block. When refining, samples on even rows and even
+** columns of the grid were already computed by the previous, twice as
+** coarse pass and are skipped; x is a multiple of step, though only even
+** for full resolution tiles when they are aligned to the cache's. Returns
+** the sum of the counts computed.
+*/
+static long	render_row(t_fractal *fract, int x, int x_end, int y)
+{
+	t_batch	b;
+	double	c[2];
+	int		pos[2];
+	int		stride;
+	long	sum;
+
+	stride = fract->step;
+	if (fract->refining && y % (2 * fract->step) == 0)
+	{
+		x += (x + fract->step) % (2 * fract->step);
+		stride = 2 * fract->step;
+	}
+	init_batch(fract, &b);
+	c[1] = fract->max_im - y * fract->factors[1];
+	while (x + b.n * stride < x_end)
+	{
+		c[0] = fract->min_re + (x + b.n * stride) * fract->factors[0];
+		fract->formula->load(fract, &b, b.n, c);
+		b.n++;
+	}
+	run_batch(fract, &b);
+	pos[1] = y;
+	sum = 0;
+	while (b.n-- > 0)
+	{
+		pos[0] = x + b.n * stride;
+		fill_block(fract, pos, b.iter[b.n], b.smooth[b.n]);
+		if (fract->orbits)
+			keep_orbit(fract, &b, b.n, pos);
+		sum += b.iter[b.n];
+	}
+	return (sum);
+}
+
+/*
+** Pixel bounds {x0, y0, x1, y1} of a tile of the current region. The tile
+** grid starts tile_shift[] pixels before the region's corner.
+*/
+void	tile_rect(t_fractal *fract, int tile, int rect[4])
+{
+	rect[0] = fract->region[0] - fract->tile_shift[0]
+		+ (tile % fract->tiles_x) * TILE_SIZE;
+	rect[1] = fract->region[1] - fract->tile_shift[1]
+		+ (tile / fract->tiles_x) * TILE_SIZE;
+	rect[2] = rect[0] + TILE_SIZE;
+	if (rect[2] > fract->region[2])
+		rect[2] = fract->region[2];
+	rect[3] = rect[1] + TILE_SIZE;
+	if (rect[3] > fract->region[3])
+		rect[3] = fract->region[3];
+	if (rect[0] < fract->region[0])
+		rect[0] = fract->region[0];
+	if (rect[1] < fract->region[1])
+		rect[1] = fract->region[1];
+}
+
+/*
+** Full resolution tiles come from the cache when it has them and go into
+** it otherwise.
+*/
+static void	render_tile(t_fractal *fract, int tile)
+{
+	int		rect[4];
+	long	start;
+	long	sum;
+	int		y;
+
+	tile_rect(fract, tile, rect);
+	if (fract->step == 1 && cache_fetch(fract, rect))
+	{
+		color_rect(fract, rect);
+		return ;
+	}
+	start = stats_now();
+	sum = 0;
+	y = rect[1];
+	while (y < rect[3])
+	{
+		sum += render_row(fract, rect[0], rect[2], y);
+		y += fract->step;
+	}
+	stats_add(&fract->stats.iterations, sum);
+	stats_add(&fract->stats.iterate, stats_now() - start);
+	if (fract->step == 1)
+		cache_store(fract, rect);
+	color_rect(fract, rect);
+}
+
+/*
+** Picks the cheapest element type that still resolves neighbouring pixels:
+** float for shallow views, double below FLOAT_SPACING. Long double is only
+** used when asked for; below DEEP_SPACING perturbation takes over anyway.
+*/
+void	select_precision(t_fractal *fract)
+{
+	t_precision	precision;
+
+	precision = fract->precision;
+	if (precision == PREC_AUTO && fract->factors[0] >= FLOAT_SPACING)
+		precision = PREC_FLOAT;
+	else if (precision == PREC_AUTO)
+		precision = PREC_DOUBLE;
+	fract->iterate = fract->kernels[precision];
+}
+
+/*
+** Brings the view state up to date for a pass over the current region and
+** returns its number of tiles.
+*/
+int	prepare_region(t_fractal *fract)
+{
+	int	tiles_y;
+
+	deep_update(fract);
+	palette_update(fract);
+	update_factors(fract);
+	select_precision(fract);
+	lattice_update(fract);
+	fract->tiles_x = (fract->region[2] - fract->region[0]
+			+ fract->tile_shift[0] + TILE_SIZE - 1) / TILE_SIZE;
+	tiles_y = (fract->region[3] - fract->region[1] + fract->tile_shift[1]
+			+ TILE_SIZE - 1) / TILE_SIZE;
+	return (fract->tiles_x * tiles_y);
+}
+
+/*
+** Rectangle subdivision relies on the set being connected, so formulas
+** without FORMULA_SUBDIVIDE always compute every pixel.
+*/
+static void	run_region(t_fractal *fract)
+{
+	int	tiles;
+
+	tiles = prepare_region(fract);
+	if (fract->subdivide && fract->step == 1
+		&& (fract->formula->flags & FORMULA_SUBDIVIDE))
+		pool_run(fract, subdivide_tile, tiles);
+	else
+		pool_run(fract, render_tile, tiles);
+}
+
+void	update_factors(t_fractal *fract)
+{
+	fract->factors[0] = (fract->max_re - fract->min_re) / (fract->width - 1);
+	fract->factors[1] = (fract->max_im - fract->min_im) / (fract->height - 1);
+}
+
+/*
+** Centers the view on (re, im) with `span` units across the real axis and
+** the imaginary extent following the image aspect ratio.
+*/
+void	set_view(t_fractal *fract, double re, double im, double span)
+{
+	double	span_im;
+
+	span_im = span * fract->height / fract->width;
+	fract->min_re = re - span / 2.0;
+	fract->max_re = re + span / 2.0;
+	fract->min_im = im - span_im / 2.0;
+	fract->max_im = im + span_im / 2.0;
+}
+
+/*
+** Renders one pass at the given sample step over the whole image. With
+** `refining` set the pass reuses the samples of the previous pass at twice
+** the step, so the 8, 4, 2, 1 sequence computes each pixel exactly once.
+** The full resolution pass ends with the anti-aliasing pass when it is on.
+*/
+void	render_pass(t_fractal *fract, int step, int refining)
+{
+	fract->step = step;
+	fract->refining = refining;
+	fract->region[0] = 0;
+	fract->region[1] = 0;
+	fract->region[2] = fract->width;
+	fract->region[3] = fract->height;
+	fract->aa.valid = 0;
+	run_region(fract);
+	if (step == 1 && fract->aa.on)
+		antialias(fract, fract->region);
+}
+
+/*
+** Renders the pixels of rect = {x0, y0, x1, y1} at full resolution and
+** leaves the rest of the image alone. An anti-aliased frame stays so.
+*/
+void	render_rect(t_fractal *fract, int rect[4])
+{
+	fract->step = 1;
+	fract->refining = 0;
+	fract->region[0] = rect[0];
+	fract->region[1] = rect[1];
+	fract->region[2] = rect[2];
+	fract->region[3] = rect[3];
+	if (rect[0] >= rect[2] || rect[1] >= rect[3])
+		return ;
+	run_region(fract);
+	if (fract->aa.valid)
+		antialias(fract, fract->region);
+}
+
+void	render_image(t_fractal *fract)
+{
+	tune_image(fract);
+	render_pass(fract, 1, 0);
+	fract->refine = 0;
+}
@@ -0,0 +1,178 @@
+#include "fract.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+** Keeps a copy of the counts on screen, the smooth counts right after the
+** integer ones, and the view they were computed with, for reproject() to
+** sample from once the view has changed.
+*/
+int	save_frame(t_fractal *fract)
+{
+	size_t	size;
+
+	size = (size_t)fract->width * fract->height * sizeof(int);
+	if (fract->prev_size < 2 * size)
+	{
+		free(fract->prev);
+		fract->prev = malloc(2 * size);
+		fract->prev_size = 0;
+		if (!fract->prev)
+			return (1);
+		fract->prev_size = 2 * size;
+	}
+	memcpy(fract->prev, fract->iters, size);
+	memcpy(fract->prev + size, fract->smooth_iters, size);
+	fract->prev_iter = fract->max_iter;
+	update_factors(fract);
+	fract->prev_view[0] = fract->min_re;
+	fract->prev_view[1] = fract->max_im;
+	fract->prev_view[2] = fract->factors[0];
+	fract->prev_view[3] = fract->factors[1];
+	return (0);
+}
+
+static int	old_pixel(double pos, int size)
+{
+	pos += 0.5;
+	if (pos < 0.0)
+		return (0);
+	if (pos > size - 1)
+		return (size - 1);
+	return ((int)pos);
+}
+
+static void	warp_row(t_fractal *fract, int y)
+{
+	double	*view;
+	float	*smooth;
+	int		old;
+	int		oy;
+	int		x;
+	int		rect[4];
+
+	view = fract->prev_view;
+	smooth = (float *)fract->prev + fract->width * fract->height;
+	oy = old_pixel((view[1] - (fract->max_im - y * fract->factors[1]))
+			/ view[3], fract->height);
+	x = 0;
+	while (x < fract->width)
+	{
+		old = oy * fract->width + old_pixel((fract->min_re + x
+					* fract->factors[0] - view[0]) / view[2], fract->width);
+		fract->iters[y * fract->width + x] = ((int *)fract->prev)[old];
+		if (((int *)fract->prev)[old] >= fract->prev_iter)
+			fract->iters[y * fract->width + x] = fract->max_iter;
+		fract->smooth_iters[y * fract->width + x] = smooth[old];
+		x++;
+	}
+	rect[0] = 0;
+	rect[1] = y;
+	rect[2] = fract->width;
+	rect[3] = y + 1;
+	color_rect(fract, rect);
+}
+
+/*
+** Instant preview for a new view: every pixel takes the count of the
+** nearest pixel of the saved frame (edges are clamped when zooming out),
+** with points of the set kept in the set when max_iter has changed.
+** The full progressive sequence then runs on the render thread and only
+** overwrites the pixels it samples, so the warp fills the gaps meanwhile.
+*/
+void	reproject(t_fractal *fract)
+{
+	fract->aa.valid = 0;
+	update_factors(fract);
+	pool_run(fract, warp_row, fract->height);
+	publish(fract);
+	fract->blocks = 0;
+	fract->first_pass = first_step(fract);
+	fract->refine = fract->first_pass;
+	fract->num_strips = 0;
+	fract->resume = 0;
+	fract->aa.pending = 0;
+}
+
+static void	shift_buffer(char *base, int line_len, int size[2], int d[2])
+{
+	int	y;
+	int	step;
+
+	y = 0;
+	step = 1;
+	if (d[1] < 0)
+	{
+		y = size[1] - 1;
+		step = -1;
+	}
+	while (y >= 0 && y < size[1])
+	{
+		if (y + d[1] >= 0 && y + d[1] < size[1])
+			memmove(base + y * line_len + (d[0] < 0) * -d[0] * 4,
+				base + (y + d[1]) * line_len + (d[0] > 0) * d[0] * 4,
+				(size_t)(size[0] - abs(d[0])) * 4);
+		y += step;
+	}
+}
+
+/*
+** Moves the counts, the colors made from them and the anti-aliasing slots
+** together, and the kept orbits as four 4-byte units per pixel.
+*/
+static void	shift_image(t_fractal *fract, int dx, int dy)
+{
+	int	size[2];
+	int	d[2];
+
+	size[0] = fract->width;
+	size[1] = fract->height;
+	d[0] = dx;
+	d[1] = dy;
+	shift_buffer(fract->addr, fract->line_len, size, d);
+	shift_buffer((char *)fract->iters, fract->width * 4, size, d);
+	shift_buffer((char *)fract->smooth_iters, fract->width * 4, size, d);
+	shift_buffer((char *)fract->aa.slot, fract->width * 4, size, d);
+	if (!fract->orbits)
+		return ;
+	size[0] *= 4;
+	d[0] *= 4;
+	shift_buffer((char *)fract->orbits, fract->width * 16, size, d);
+}
+
+/*
+** Moves the view by a whole number of pixels. When the frame on screen is
+** complete, its overlapping part is moved in place and only the strips the
+** pan uncovers are left to the render thread; otherwise a new progressive
+** render starts.
+*/
+void	pan_view(t_fractal *fract, int dx, int dy)
+{
+	int	*rect;
+
+	stop_render(fract);
+	update_factors(fract);
+	fract->min_re += dx * fract->factors[0];
+	fract->max_re += dx * fract->factors[0];
+	fract->min_im -= dy * fract->factors[1];
+	fract->max_im -= dy * fract->factors[1];
+	if (render_pending(fract) || fract->warp || abs(dx) >= fract->width
+		|| abs(dy) >= fract->height)
+	{
+		render_fractal(fract);
+		return ;
+	}
+	shift_image(fract, dx, dy);
+	rect = fract->strips[0];
+	rect[0] = (dx > 0) * (fract->width - dx);
+	rect[1] = 0;
+	rect[2] = fract->width - (dx < 0) * (fract->width + dx);
+	rect[3] = fract->height;
+	fract->num_strips = (dx != 0);
+	rect = fract->strips[fract->num_strips];
+	rect[0] = 0;
+	rect[1] = (dy > 0) * (fract->height - dy);
+	rect[2] = fract->width;
+	rect[3] = fract->height - (dy < 0) * (fract->height + dy);
+	fract->num_strips += (dy != 0);
+}
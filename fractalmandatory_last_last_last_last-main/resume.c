@@ -0,0 +1,216 @@
+#include "fract.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*
+** Window mode keeps, two doubles per pixel, the z every pixel stopped at,
+** so that raising max_iter continues the orbits the cap cut short instead
+** of starting them over. NaN marks an escaped pixel, whose count is final;
+** infinity a capped one whose z is unknown, which starts over.
+*/
+int	alloc_orbits(t_fractal *fract, int width, int height)
+{
+	double	*orbits;
+
+	orbits = malloc((size_t)width * height * 2 * sizeof(double));
+	if (!orbits)
+	{
+		printf("Error: Cannot allocate a %dx%d orbit buffer\n", width, height);
+		return (1);
+	}
+	free(fract->orbits);
+	fract->orbits = orbits;
+	fract->resume = 0;
+	return (0);
+}
+
+/*
+** Records where lane i of a batch just run stopped, for pixel pos. The
+** long double kernel's z would lose its extra bits here, so its capped
+** pixels start over.
+*/
+void	keep_orbit(t_fractal *fract, t_batch *b, int i, int pos[2])
+{
+	double	*z;
+
+	z = fract->orbits + 2 * ((long)pos[1] * fract->width + pos[0]);
+	z[0] = NAN;
+	z[1] = NAN;
+	if (b->iter[i] < b->max_iter)
+		return ;
+	z[0] = b->zr[i];
+	z[1] = b->zi[i];
+	if (!b->deep && fract->iterate == fract->kernels[PREC_LONG])
+		z[0] = INFINITY;
+}
+
+/*
+** For counts that did not come from render_row(): cached tiles and
+** subdivided ones.
+*/
+void	forget_orbits(t_fractal *fract, int rect[4])
+{
+	double	*z;
+	int		x;
+	int		y;
+
+	y = rect[1] - 1;
+	while (++y < rect[3])
+	{
+		x = rect[0] - 1;
+		while (++x < rect[2])
+		{
+			z = fract->orbits + 2 * ((long)y * fract->width + x);
+			z[0] = NAN;
+			if (fract->iters[y * fract->width + x] >= fract->max_iter)
+				z[0] = INFINITY;
+		}
+	}
+}
+
+/*
+** Runs batch k of a row and stores its lanes. Batch 0 continues orbits
+** that stopped at `base` for the rest of max_iter, batch 1 starts from
+** scratch. Counts are made absolute before smoothing, so both give what
+** a full run would. Returns the iterations done.
+*/
+static long	flush(t_fractal *fract, t_resume *r, int k)
+{
+	t_batch	*b;
+	int		pos[2];
+	long	sum;
+	int		i;
+
+	b = r->batch + k;
+	b->max_iter = fract->max_iter - r->base[k];
+	if (b->deep)
+		iterate_perturb(b);
+	else
+		fract->iterate(b);
+	b->max_iter = fract->max_iter;
+	sum = 0;
+	i = -1;
+	while (++i < b->n)
+	{
+		sum += b->iter[i];
+		b->iter[i] += r->base[k];
+		b->steps[i] += r->base[k];
+	}
+	if (b->flags & SMOOTH_COUNT)
+		smooth_batch(b);
+	else if (fract->smooth)
+		plain_batch(b);
+	pos[1] = r->y;
+	while (b->n-- > 0)
+	{
+		pos[0] = r->x[k][b->n];
+		fill_block(fract, pos, b->iter[b->n], b->smooth[b->n]);
+		keep_orbit(fract, b, b->n, pos);
+	}
+	b->n = 0;
+	return (sum);
+}
+
+/*
+** Adds the pixel at x of the row to batch 0 when its orbit can go on from
+** where it stopped, to batch 1 otherwise. Batch 0 holds orbits that all
+** stopped at the same count. Returns the iterations done by batches that
+** filled up.
+*/
+static long	gather(t_fractal *fract, t_resume *r, int x, const double *z)
+{
+	double	c[2];
+	long	sum;
+	int		k;
+
+	sum = 0;
+	k = isinf(z[0]);
+	if (!k && r->batch[0].n > 0
+		&& fract->iters[r->y * fract->width + x] != r->base[0])
+		sum += flush(fract, r, 0);
+	if (!k)
+		r->base[0] = fract->iters[r->y * fract->width + x];
+	c[0] = fract->min_re + x * fract->factors[0];
+	c[1] = fract->max_im - r->y * fract->factors[1];
+	fract->formula->load(fract, r->batch + k, r->batch[k].n, c);
+	if (!k)
+	{
+		r->batch[0].zr[r->batch[0].n] = z[0];
+		r->batch[0].zi[r->batch[0].n] = z[1];
+	}
+	r->x[k][r->batch[k].n++] = x;
+	if (r->batch[k].n == BATCH_SIZE)
+		sum += flush(fract, r, k);
+	return (sum);
+}
+
+/*
+** Continues every step-th pixel of row y between x and x_end that the cap
+** stopped below the current max_iter.
+*/
+static long	resume_row(t_fractal *fract, t_resume *r, int x, int x_end)
+{
+	const double	*z;
+	long			sum;
+
+	sum = 0;
+	while (x < x_end)
+	{
+		z = fract->orbits + 2 * ((long)r->y * fract->width + x);
+		if (!isnan(z[0])
+			&& fract->iters[r->y * fract->width + x] < fract->max_iter)
+			sum += gather(fract, r, x, z);
+		x += fract->step;
+	}
+	if (r->batch[0].n > 0)
+		sum += flush(fract, r, 0);
+	if (r->batch[1].n > 0)
+		sum += flush(fract, r, 1);
+	return (sum);
+}
+
+static void	resume_tile(t_fractal *fract, int tile)
+{
+	t_resume	r;
+	int			rect[4];
+	long		start;
+	long		sum;
+
+	tile_rect(fract, tile, rect);
+	start = stats_now();
+	init_batch(fract, r.batch);
+	init_batch(fract, r.batch + 1);
+	r.batch[0].flags |= RESUME_ORBIT;
+	r.base[1] = 0;
+	sum = 0;
+	r.y = rect[1];
+	while (r.y < rect[3])
+	{
+		sum += resume_row(fract, &r, rect[0], rect[2]);
+		r.y += fract->step;
+	}
+	stats_add(&fract->stats.iterations, sum);
+	stats_add(&fract->stats.iterate, stats_now() - start);
+	if (fract->step == 1)
+		cache_store(fract, rect);
+	color_rect(fract, rect);
+}
+
+/*
+** After max_iter went up: continues the samples of a pass at `step` over
+** the whole image, or of the complete frame at 1, that the old cap
+** stopped. Escaped samples keep their counts, so the work is about what
+** the extra iterations cost the pixels still going. A run cut short can
+** simply be repeated: what it did is no longer below the cap.
+*/
+void	resume_pass(t_fractal *fract, int step)
+{
+	fract->step = step;
+	fract->refining = 0;
+	fract->region[0] = 0;
+	fract->region[1] = 0;
+	fract->region[2] = fract->width;
+	fract->region[3] = fract->height;
+	fract->aa.valid = 0;
+	pool_run(fract, resume_tile, prepare_region(fract));
+}
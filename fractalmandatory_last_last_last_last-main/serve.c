@@ -0,0 +1,302 @@
+#include "fract.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t	g_stop;
+
+static void	on_signal(int sig)
+{
+	(void)sig;
+	g_stop = 1;
+}
+
+/*
+** Sends a complete response and ignores write errors: the client may have
+** gone away, which only concerns that client. A NULL body is an error
+** response carrying its status line; 503 asks the client to retry in a
+** second.
+*/
+void	serve_respond(int fd, const char *status, const char *body, size_t len)
+{
+	char		head[256];
+	const char	*extra;
+	ssize_t		n;
+
+	extra = "Content-Type: text/plain\r\n";
+	if (body)
+		extra = "Content-Type: image/png\r\n"
+			"Cache-Control: public, max-age=86400\r\n";
+	else if (strncmp(status, "503", 3) == 0)
+		extra = "Content-Type: text/plain\r\nRetry-After: 1\r\n";
+	if (!body)
+		body = status;
+	if (body == status)
+		len = strlen(status);
+	n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\n%sContent-Length: %zu"
+			"\r\nConnection: close\r\n\r\n", status, extra, len);
+	if (send(fd, head, n, MSG_NOSIGNAL) != n)
+		return ;
+	while (len > 0)
+	{
+		n = send(fd, body, len, MSG_NOSIGNAL);
+		if (n <= 0)
+			return ;
+		body += n;
+		len -= n;
+	}
+}
+
+static int	path_number(const char **s, double max, char end, long *out)
+{
+	const char	*start;
+	double		value;
+
+	start = *s;
+	value = is_it_int(s);
+	if (*s == start || value > max || **s != end)
+		return (1);
+	(*s)++;
+	*out = (long)value;
+	return (0);
+}
+
+/*
+** Reads the formula name of the path into req, followed by its slash.
+*/
+static int	path_formula(const char **s, t_request *req)
+{
+	const t_formula	*formula;
+	char			name[32];
+	int				len;
+
+	len = 0;
+	while ((*s)[len] && (*s)[len] != '/' && len < (int)sizeof(name) - 1)
+	{
+		name[len] = (*s)[len];
+		len++;
+	}
+	name[len] = '\0';
+	formula = find_formula(name);
+	if (!formula || (*s)[len] != '/')
+		return (1);
+	req->type = formula->type;
+	*s += len + 1;
+	return (0);
+}
+
+/*
+** Reads `GET /tile/<fractal>/{z}/{x}/{y}.png` off the request head into
+** req, for any fractal of the formula table; a query string is ignored.
+** Returns the status line to answer with when it is not such a request.
+*/
+static const char	*parse_request(const char *head, t_request *req)
+{
+	const char	*s;
+	long		z;
+
+	if (strncmp(head, "GET ", 4) != 0)
+		return ("405 Method Not Allowed");
+	s = head + 4;
+	if (strncmp(s, "/tile/", 6) != 0)
+		return ("404 Not Found");
+	s += 6;
+	if (path_formula(&s, req)
+		|| path_number(&s, SERVE_MAX_ZOOM, '/', &z)
+		|| path_number(&s, ldexp(1.0, z) - 1, '/', &req->x)
+		|| path_number(&s, ldexp(1.0, z) - 1, '.', &req->y)
+		|| strncmp(s, "png", 3) != 0 || (s[3] != ' ' && s[3] != '?'))
+		return ("404 Not Found");
+	req->z = (int)z;
+	return (NULL);
+}
+
+/*
+** Hands a connection whose head is complete to the queue. A full queue is
+** answered with 503 straight away, which is the daemon's backpressure.
+*/
+static void	dispatch(t_server *server, t_client *c)
+{
+	t_request	req;
+	const char	*error;
+
+	c->head[c->len] = '\0';
+	error = parse_request(c->head, &req);
+	if (!error && serve_enqueue(server, &req, c->fd) == 0)
+		return ;
+	if (!error)
+		error = "503 Service Unavailable";
+	serve_respond(c->fd, error, NULL, 0);
+	close(c->fd);
+}
+
+/*
+** Reads what has arrived of a request head without waiting for more.
+** Returns 1 once the connection was handed over, answered, or dropped
+** because the client closed it or it failed.
+*/
+static int	read_head(t_server *server, t_client *c)
+{
+	ssize_t	n;
+
+	n = recv(c->fd, c->head + c->len, SERVE_HEAD - 1 - c->len, MSG_DONTWAIT);
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return (0);
+	if (n <= 0)
+	{
+		close(c->fd);
+		return (1);
+	}
+	c->len += n;
+	if (c->len < SERVE_HEAD - 1 && !memchr(c->head, '\n', c->len))
+		return (0);
+	dispatch(server, c);
+	return (1);
+}
+
+/*
+** Adds a new connection to the pending ones, or answers 503 when
+** SERVE_PENDING heads are already arriving. Sends get SERVE_TIMEOUT
+** seconds, so a client that stops reading cannot hold up a worker.
+*/
+static void	accept_client(int fd, t_client *clients, int *count)
+{
+	struct timeval	timeout;
+	int				client;
+
+	client = accept(fd, NULL, NULL);
+	if (client < 0)
+		return ;
+	if (*count == SERVE_PENDING)
+	{
+		serve_respond(client, "503 Service Unavailable", NULL, 0);
+		close(client);
+		return ;
+	}
+	timeout.tv_sec = SERVE_TIMEOUT;
+	timeout.tv_usec = 0;
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	clients[*count].fd = client;
+	clients[*count].len = 0;
+	clients[*count].since = stats_now();
+	(*count)++;
+}
+
+/*
+** One round of the accept loop: waits for the listening socket or any
+** pending connection, reads the heads that arrived, answers 408 to those
+** still incomplete after SERVE_TIMEOUT seconds and takes a new connection.
+** Nothing here blocks on a single client.
+*/
+static void	serve_round(t_server *server, int fd, t_client *c, int *count)
+{
+	struct pollfd	fds[SERVE_PENDING + 1];
+	int				done;
+	int				i;
+
+	i = -1;
+	while (++i <= *count)
+	{
+		fds[i].fd = fd;
+		if (i > 0)
+			fds[i].fd = c[i - 1].fd;
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+	if (poll(fds, *count + 1, SERVE_POLL_MS) < 0)
+		return ;
+	i = *count;
+	while (i-- > 0)
+	{
+		done = fds[i + 1].revents && read_head(server, c + i);
+		if (!done && stats_now() - c[i].since > SERVE_TIMEOUT * 1000000000L)
+		{
+			serve_respond(c[i].fd, "408 Request Timeout", NULL, 0);
+			close(c[i].fd);
+			done = 1;
+		}
+		if (done)
+			c[i] = c[--(*count)];
+	}
+	if (fds[0].revents)
+		accept_client(fd, c, count);
+}
+
+static int	listen_on(int port)
+{
+	struct sockaddr_in	addr;
+	int					fd;
+	int					on;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	on = 1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on))
+		|| bind(fd, (struct sockaddr *)&addr, sizeof(addr))
+		|| listen(fd, SERVE_QUEUE) || fcntl(fd, F_SETFL, O_NONBLOCK))
+	{
+		printf("Error: Cannot listen on port %d\n", port);
+		if (fd >= 0)
+			close(fd);
+		return (-1);
+	}
+	return (fd);
+}
+
+/*
+** `./fractol serve <fractal> [parameters] [options] [--port N]`: renders
+** SERVE_TILE pixel PNG tiles on request through the same pool and kernels
+** as the window, for a web viewer on this machine. The fractal argument
+** only supplies the Julia parameters, --power the Multibrot degree; the
+** URL picks the fractal. Runs until SIGINT or SIGTERM.
+*/
+int	serve(int argc, char **argv)
+{
+	t_fractal			fract;
+	t_options			opt;
+	t_server			server;
+	t_client			clients[SERVE_PENDING];
+	struct sigaction	sa;
+	int					count;
+	int					fd;
+
+	init_fractal(&fract);
+	if (argc < 2)
+		print_usage();
+	if (argc < 2 || parse_args(argc, argv, &fract, &opt))
+		return (1);
+	fd = listen_on(opt.port);
+	if (fd < 0)
+		return (1);
+	if (serve_start(&server, argc, argv))
+	{
+		close(fd);
+		return (1);
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	printf("Serving http://127.0.0.1:%d/tile/<fractal>/{z}/{x}/{y}.png\n",
+		opt.port);
+	fflush(stdout);
+	count = 0;
+	while (!g_stop)
+		serve_round(&server, fd, clients, &count);
+	while (count > 0)
+		close(clients[--count].fd);
+	serve_stop(&server);
+	close(fd);
+	return (0);
+}
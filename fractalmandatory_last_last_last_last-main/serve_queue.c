@@ -0,0 +1,254 @@
+#include "fract.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+** Queues a tile request for `client`, or adds the client to an identical
+** request already queued or rendering. Returns 1 when neither is possible
+** because the queue or the request's client list is full; the caller then
+** turns the client away.
+*/
+int	serve_enqueue(t_server *server, const t_request *req, int client)
+{
+	t_request	*r;
+	t_request	*free_slot;
+
+	free_slot = NULL;
+	pthread_mutex_lock(&server->lock);
+	r = server->queue;
+	while (r < server->queue + SERVE_QUEUE && (r->state == REQ_FREE
+			|| r->type != req->type || r->z != req->z || r->x != req->x
+			|| r->y != req->y))
+	{
+		if (r->state == REQ_FREE && !free_slot)
+			free_slot = r;
+		r++;
+	}
+	if (r == server->queue + SERVE_QUEUE && free_slot)
+	{
+		r = free_slot;
+		*r = *req;
+		r->state = REQ_QUEUED;
+		r->seq = server->seq++;
+		r->count = 0;
+		pthread_cond_signal(&server->ready);
+	}
+	if (r < server->queue + SERVE_QUEUE && r->count < SERVE_WAITERS)
+		r->clients[r->count++] = client;
+	else
+		r = NULL;
+	pthread_mutex_unlock(&server->lock);
+	return (r == NULL);
+}
+
+/*
+** Waits for the oldest queued request and marks it rendering. Returns NULL
+** once the server stops.
+*/
+static t_request	*next_request(t_server *server)
+{
+	t_request	*r;
+	t_request	*oldest;
+
+	pthread_mutex_lock(&server->lock);
+	oldest = NULL;
+	while (!oldest && !server->stop)
+	{
+		r = server->queue;
+		while (r < server->queue + SERVE_QUEUE)
+		{
+			if (r->state == REQ_QUEUED && (!oldest || r->seq < oldest->seq))
+				oldest = r;
+			r++;
+		}
+		if (!oldest && !server->stop)
+			pthread_cond_wait(&server->ready, &server->lock);
+	}
+	if (oldest)
+		oldest->state = REQ_RENDERING;
+	pthread_mutex_unlock(&server->lock);
+	return (oldest);
+}
+
+/*
+** Renders the tile into the worker's SERVE_TILE square image. Zoom level z
+** splits a 4 x 4 square, from (-2.5, 2) for the Mandelbrot set and from
+** (-2, 2) for Julia sets, into 2^z x 2^z tiles. The spacing is a power of
+** two and the corners are multiples of it, so tiles sit on the lattice of
+** the tile store and are computed exactly as the viewer computes them.
+*/
+static void	render_request(t_fractal *fract, const t_request *r)
+{
+	double	spacing;
+
+	spacing = ldexp(4.0 / SERVE_TILE, -r->z);
+	set_formula(fract, r->type);
+	fract->min_re = -2.0 - 0.5 * (r->type == MANDELBROT)
+		+ (double)(r->x * SERVE_TILE) * spacing;
+	fract->max_re = fract->min_re + (SERVE_TILE - 1) * spacing;
+	fract->max_im = 2.0 - (double)(r->y * SERVE_TILE) * spacing;
+	fract->min_im = fract->max_im - (SERVE_TILE - 1) * spacing;
+	render_image(fract);
+}
+
+/*
+** Takes the clients of a finished request and frees its slot, so requests
+** for the same tile arriving from now on render it again.
+*/
+static int	take_clients(t_server *server, t_request *r, int *clients)
+{
+	int	count;
+
+	pthread_mutex_lock(&server->lock);
+	count = r->count;
+	memcpy(clients, r->clients, count * sizeof(int));
+	r->state = REQ_FREE;
+	pthread_mutex_unlock(&server->lock);
+	return (count);
+}
+
+static void	*serve_worker(void *arg)
+{
+	t_worker	*w;
+	t_request	*r;
+	FILE		*file;
+	char		*png;
+	size_t		len;
+	int			clients[SERVE_WAITERS];
+	int			count;
+	int			failed;
+
+	w = arg;
+	r = next_request(w->server);
+	while (r)
+	{
+		render_request(w->fract, r);
+		png = NULL;
+		file = open_memstream(&png, &len);
+		failed = !file || write_png_stream(w->fract, file);
+		if (file)
+			failed |= fclose(file);
+		if (failed)
+			len = 0;
+		count = take_clients(w->server, r, clients);
+		while (count-- > 0)
+		{
+			if (len)
+				serve_respond(clients[count], "200 OK", png, len);
+			else
+				serve_respond(clients[count], "500 Internal Server Error",
+					NULL, 0);
+			close(clients[count]);
+		}
+		free(png);
+		stats_tick(w->fract, 0);
+		r = next_request(w->server);
+	}
+	return (NULL);
+}
+
+static void	free_worker(t_worker *w)
+{
+	pool_destroy(&w->fract->pool);
+	free(w->fract->addr);
+	free(w->fract->iters);
+	free(w->fract->smooth_iters);
+	aa_free(&w->fract->aa);
+	deep_free(w->fract);
+	palette_free(&w->fract->colors);
+	store_close(&w->fract->store);
+	free(w->fract);
+}
+
+/*
+** Each worker parses the command line into a t_fractal of its own, with a
+** SERVE_TILE square image and its own render pool. max_iter is the same
+** for every tile, so neighbouring tiles match.
+*/
+static int	setup_worker(t_worker *w, int argc, char **argv)
+{
+	t_options	opt;
+
+	w->fract = malloc(sizeof(t_fractal));
+	if (!w->fract)
+		return (1);
+	init_fractal(w->fract);
+	if (parse_args(argc, argv, w->fract, &opt)
+		|| (opt.store && store_open(&w->fract->store, opt.store)))
+	{
+		free(w->fract);
+		return (1);
+	}
+	w->fract->tuning.auto_iter = 0;
+	w->fract->width = SERVE_TILE;
+	w->fract->height = SERVE_TILE;
+	if (alloc_buffer(w->fract))
+	{
+		store_close(&w->fract->store);
+		free(w->fract);
+		return (1);
+	}
+	pool_init(w->fract);
+	return (0);
+}
+
+int	serve_start(t_server *server, int argc, char **argv)
+{
+	t_worker	*w;
+
+	memset(server->queue, 0, sizeof(server->queue));
+	server->seq = 0;
+	server->stop = 0;
+	server->num_workers = 0;
+	pthread_mutex_init(&server->lock, NULL);
+	pthread_cond_init(&server->ready, NULL);
+	while (server->num_workers < SERVE_WORKERS)
+	{
+		w = server->workers + server->num_workers;
+		w->server = server;
+		if (setup_worker(w, argc, argv))
+			break ;
+		if (pthread_create(&w->thread, NULL, serve_worker, w))
+		{
+			free_worker(w);
+			break ;
+		}
+		server->num_workers++;
+	}
+	return (server->num_workers == 0);
+}
+
+/*
+** Lets the workers finish the tiles they are rendering and turns away the
+** clients of requests still queued.
+*/
+void	serve_stop(t_server *server)
+{
+	t_request	*r;
+
+	pthread_mutex_lock(&server->lock);
+	server->stop = 1;
+	pthread_cond_broadcast(&server->ready);
+	pthread_mutex_unlock(&server->lock);
+	while (server->num_workers > 0)
+	{
+		server->num_workers--;
+		pthread_join(server->workers[server->num_workers].thread, NULL);
+		free_worker(server->workers + server->num_workers);
+	}
+	r = server->queue;
+	while (r < server->queue + SERVE_QUEUE)
+	{
+		while (r->state != REQ_FREE && r->count > 0)
+		{
+			serve_respond(r->clients[--r->count], "503 Service Unavailable",
+				NULL, 0);
+			close(r->clients[r->count]);
+		}
+		r++;
+	}
+	pthread_mutex_destroy(&server->lock);
+	pthread_cond_destroy(&server->ready);
+}
@@ -0,0 +1,166 @@
+#include "fract.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+void	print_usage(void)
+{
+	write(1, "Usage: ./fractol [fractal_type] [parameters]\n\n", 47);
+	write(1, "Available fractals:\n", 20);
+	write(1, "  mandelbrot          - Display Mandelbrot set\n", 47);
+	write(1, "  julia [c_re] [c_im] - Display Julia set with parameters\n", 58);
+	write(1, "                        ", 24);
+	write(1, "Example: ./fractol julia -0.7 0.27\n", 35);
+	write(1, "  burning_ship        - Display the Burning Ship fractal\n", 57);
+	write(1, "  tricorn             - Display the Tricorn (Mandelbar) set\n", 60);
+	write(1, "  multibrot           - Display z^n + c, n set by --power\n", 58);
+	write(1, "  newton              - Newton's method for z^3 - 1\n\n", 53);
+	write(1, "Options: [--size WxH] [--iter N|auto] [--center RE IM]\n", 55);
+	write(1, "         [--span W] [--budget MS] (first pass to fit, 0 = off)\n", 63);
+	write(1, "         [--exact]   (no cardioid/bulb or cycle shortcuts)\n", 59);
+	write(1, "         [--power N] (Multibrot degree, 2 to 16, default 3)\n", 60);
+	write(1, "         [--subdivide] (Mariani-Silver rectangle fill)\n", 55);
+	write(1, "         [--precision auto|float|double|long]\n", 46);
+	write(1, "         [--palette default|fire|ocean|psychedelic|", 51);
+	write(1, "grayscale|rainbow] [--shift F]\n", 31);
+	write(1, "         [--smooth]  (continuous coloring)\n", 43);
+	write(1, "         [--aa]      (supersample edge pixels)\n", 47);
+	write(1, "         [--stats]   (hot path counters on stderr as JSON)\n", 59);
+	write(1, "         [--cache MB] (tile cache size, 0 = off)\n", 49);
+	write(1, "         [--store FILE] (read tiles precomputed into FILE)\n\n",
+		60);
+	write(1, "Headless:\n", 10);
+	write(1, "  render [fractal] [parameters] [options] --out <file.ppm|file.png>\n\n", 69);
+	write(1, "Precompute:\n", 12);
+	write(1, "  precompute [fractal] [parameters] [options] --store <file>\n", 61);
+	write(1, "             [--levels N]  (N zoom levels below the view)\n\n",
+		59);
+	write(1, "Tile daemon:\n", 13);
+	write(1, "  serve [fractal] [parameters] [options] [--port N]\n", 52);
+	write(1, "        GET /tile/<fractal>/{z}/{x}/{y}.png\n\n", 45);
+	write(1, "Benchmark:\n", 11);
+	write(1, "  bench [--size WxH] [--frames N] [--json FILE]\n", 48);
+	write(1, "  verify [--size WxH]  (check fast paths against scalar)\n", 57);
+	write(1, "         [--record]    (rewrite the golden/ reference files)\n\n",
+		62);
+	write(1, "Controls:\n", 10);
+	write(1, "  Mouse wheel - Zoom in/out\n", 28);
+	write(1, "  WASD/Arrows - Pan\n", 20);
+	write(1, "  E           - Toggle exact (brute-force) iteration\n", 53);
+	write(1, "  M           - Toggle rectangle subdivision\n", 45);
+	write(1, "  C           - Next color palette\n", 35);
+	write(1, "  Space       - Toggle color cycling\n", 37);
+	write(1, "  G           - Toggle smooth coloring\n", 39);
+	write(1, "  X           - Toggle anti-aliasing\n", 37);
+	write(1, "  I           - Toggle performance HUD\n", 39);
+	write(1, "  + / -       - Double / halve max iterations\n", 46);
+	write(1, "  ESC         - Exit program\n", 29);
+}
+
+void	init_fractal(t_fractal *fract)
+{
+	fract->width = WIDTH;
+	fract->height = HEIGHT;
+	fract->min_re = -2.5;
+	fract->max_re = 2.5;
+	fract->min_im = -2.0;
+	fract->max_im = fract->min_im + (fract->max_re
+			- fract->min_re) * fract->height / fract->width;
+	fract->c_re = -0.7;
+	fract->c_im = 0.27;
+	fract->max_iter = MAX_ITER;
+	fract->tuning.auto_iter = 1;
+	fract->tuning.scale = 1.0;
+	fract->tuning.budget_ms = 0;
+	fract->tuning.sample_ns = 0.0;
+	fract->tuning.sample_iter = 0;
+	fract->shortcuts = SHORTCUT_BULBS | SHORTCUT_PERIOD;
+	fract->subdivide = 0;
+	fract->palette = PALETTE_DEFAULT;
+	fract->color_shift = 0.0;
+	fract->animate = 0;
+	fract->smooth = 0;
+	fract->iters = NULL;
+	fract->smooth_iters = NULL;
+	fract->orbits = NULL;
+	memset(&fract->colors, 0, sizeof(t_palette));
+	memset(&fract->aa, 0, sizeof(t_aa));
+	memset(&fract->cache, 0, sizeof(t_cache));
+	memset(&fract->store, 0, sizeof(t_store));
+	fract->cache.cap = (size_t)CACHE_MB << 20;
+	fract->cached = 0;
+	memset(&fract->deep, 0, sizeof(t_deep));
+	fract->power = MULTIBROT_POWER;
+	set_formula(fract, MANDELBROT);
+	fract->precision = PREC_AUTO;
+	fract->refine = 0;
+	fract->resume = 0;
+	fract->blocks = 1;
+	fract->prev = NULL;
+	fract->prev_size = 0;
+	fract->first_pass = PREVIEW_STEP;
+	fract->warp = 0;
+	fract->num_strips = 0;
+	memset(&fract->async, 0, sizeof(t_async));
+	fract->async.front = 1;
+	fract->async.ready = -1;
+	stats_init(fract);
+}
+
+/*
+** Reads the fractal type, the Julia constant and any trailing options, then
+** frames the view for the requested image size. Tiles read from a store
+** were computed with a fixed max_iter, so a store turns auto off.
+*/
+int	parse_args(int argc, char **argv, t_fractal *fract, t_options *opt)
+{
+	const t_formula	*f;
+
+	f = find_formula(argv[1]);
+	if (!f)
+		printf("Error: Invalid fractal type '%s'\n\n", argv[1]);
+	else if (argc < 2 + f->params)
+		printf("Error: Julia set requires two parameters\n");
+	if (!f || argc < 2 + f->params)
+	{
+		print_usage();
+		return (1);
+	}
+	if (f->params)
+	{
+		fract->c_re = ft_atof(argv[2]);
+		fract->c_im = ft_atof(argv[3]);
+	}
+	if (parse_options(argc - 2 - f->params, argv + 2 + f->params, fract, opt))
+		return (1);
+	if (opt->power)
+		fract->power = opt->power;
+	set_formula(fract, f->type);
+	fract->tuning.budget_ms = opt->budget;
+	if (opt->store)
+		fract->tuning.auto_iter = 0;
+	if (opt->center_text[0])
+		deep_origin(fract, opt->center_text, opt->span);
+	else
+		set_view(fract, opt->center[0], opt->center[1], opt->span);
+	return (0);
+}
+
+/*
+** The commands that need no window, shared by both executables. Returns -1
+** when argv[1] names none of them.
+*/
+int	run_command(int argc, char **argv)
+{
+	if (ft_strcmp(argv[1], "render") == 0)
+		return (render_headless(argc - 1, argv + 1));
+	if (ft_strcmp(argv[1], "precompute") == 0)
+		return (precompute(argc - 1, argv + 1));
+	if (ft_strcmp(argv[1], "serve") == 0)
+		return (serve(argc - 1, argv + 1));
+	if (ft_strcmp(argv[1], "bench") == 0)
+		return (bench(argc - 1, argv + 1));
+	if (ft_strcmp(argv[1], "verify") == 0)
+		return (verify(argc - 1, argv + 1));
+	return (-1);
+}
@@ -0,0 +1,100 @@
+#include "fract.h"
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+long	stats_now(void)
+{
+	struct timespec	t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec * 1000000000L + t.tv_nsec);
+}
+
+/*
+** Counters shared by the pool's workers are only ever added to, once per
+** tile, so relaxed atomics are enough and cost next to nothing.
+*/
+void	stats_add(long *counter, long value)
+{
+	__atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+void	stats_init(t_fractal *fract)
+{
+	memset(&fract->stats, 0, sizeof(t_stats));
+	memset(&fract->shown, 0, sizeof(t_stats));
+	fract->stats.start = stats_now();
+	fract->show_info = 0;
+	fract->report = 0;
+}
+
+static void	dump_threads(const t_stats *s, int threads, int idle)
+{
+	long	ns;
+	int		i;
+
+	i = 0;
+	while (i < threads)
+	{
+		ns = s->busy[i];
+		if (idle)
+			ns = s->pool - ns;
+		if (i++ > 0)
+			fprintf(stderr, ", ");
+		fprintf(stderr, "%.2f", ns / 1e6);
+	}
+}
+
+/*
+** One JSON object per line on stderr, times in milliseconds. A thread's
+** idle time is the part of the pool time it spent waiting for tiles.
+*/
+static void	dump(const t_stats *s, int threads)
+{
+	fprintf(stderr, "{\"period_ms\": %.1f, \"frames\": %ld, \"iterate_ms\": "
+		"%.2f, \"color_ms\": %.2f, \"aa_ms\": %.2f, \"blit_ms\": %.2f, "
+		"\"pool_ms\": %.2f, \"iterations\": %ld, \"cache_hits\": %ld, "
+		"\"cache_misses\": %ld, \"busy_ms\": [", s->period / 1e6, s->frames,
+		s->iterate / 1e6, s->color / 1e6, s->aa / 1e6, s->blit / 1e6,
+		s->pool / 1e6, s->iterations, s->cache_hits, s->cache_misses);
+	dump_threads(s, threads, 0);
+	fprintf(stderr, "], \"idle_ms\": [");
+	dump_threads(s, threads, 1);
+	fprintf(stderr, "]}\n");
+}
+
+int	stats_threads(t_fractal *fract)
+{
+	if (fract->pool.num_threads > 0)
+		return (fract->pool.num_threads);
+	return (1);
+}
+
+/*
+** Closes the period once STATS_PERIOD_MS have passed, or straight away
+** with `force`: its counters become the ones the HUD shows and, with
+** --stats, are written to stderr. Periods in which the pool did no work
+** are dropped. Returns 1 when a period was closed.
+*/
+int	stats_tick(t_fractal *fract, int force)
+{
+	long	now;
+
+	now = stats_now();
+	if (!force && now - fract->stats.start < STATS_PERIOD_MS * 1000000L)
+		return (0);
+	if (!force && fract->stats.pool == 0)
+	{
+		memset(&fract->stats, 0, sizeof(t_stats));
+		fract->stats.start = now;
+		return (0);
+	}
+	fract->stats.period = now - fract->stats.start;
+	fract->shown = fract->stats;
+	memset(&fract->stats, 0, sizeof(t_stats));
+	fract->stats.start = now;
+	if (fract->report)
+		dump(&fract->shown, stats_threads(fract));
+	return (1);
+}
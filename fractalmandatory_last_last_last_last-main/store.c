@@ -0,0 +1,107 @@
+#include "fract.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t	tiles_offset(const t_store_head *head)
+{
+	size_t	page;
+
+	page = (size_t)sysconf(_SC_PAGESIZE);
+	return ((sizeof(t_store_head) + (size_t)head->tiles + page - 1)
+		/ page * page);
+}
+
+size_t	store_size(const t_store_head *head)
+{
+	return (tiles_offset(head) + (size_t)head->tiles * sizeof(t_counts));
+}
+
+/*
+** Maps a store file laid out as `head` describes; prot is PROT_READ for
+** the viewers and adds PROT_WRITE for precompute.
+*/
+int	store_map(t_store *store, int fd, const t_store_head *head, int prot)
+{
+	store->size = store_size(head);
+	store->map = mmap(NULL, store->size, prot, MAP_SHARED, fd, 0);
+	if (store->map == MAP_FAILED)
+	{
+		store->map = NULL;
+		printf("Error: Cannot map the tile store\n");
+		return (1);
+	}
+	store->head = (t_store_head *)store->map;
+	store->done = store->map + sizeof(t_store_head);
+	store->tiles = (t_counts *)(store->map + tiles_offset(head));
+	return (0);
+}
+
+/*
+** Maps a store written by `./fractol precompute` read-only. Its tiles are
+** used wherever the view parameters match, also while precompute is still
+** filling it in.
+*/
+int	store_open(t_store *store, const char *path)
+{
+	t_store_head	head;
+	struct stat		st;
+	int				fd;
+	int				status;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("Error: Cannot open '%s'\n", path);
+		return (1);
+	}
+	status = read(fd, &head, sizeof(head)) != (ssize_t)sizeof(head)
+		|| memcmp(head.magic, STORE_MAGIC, sizeof(head.magic))
+		|| head.version != STORE_VERSION || head.levels < 1
+		|| head.levels > STORE_LEVELS || fstat(fd, &st)
+		|| (size_t)st.st_size != store_size(&head);
+	if (status)
+		printf("Error: '%s' is not a tile store\n", path);
+	else
+		status = store_map(store, fd, &head, PROT_READ);
+	close(fd);
+	return (status);
+}
+
+void	store_close(t_store *store)
+{
+	if (store->map)
+		munmap(store->map, store->size);
+	store->map = NULL;
+	store->head = NULL;
+}
+
+/*
+** The stored counts for key, or NULL when the store was built with other
+** parameters, does not reach that far or has not computed the tile yet.
+*/
+const t_counts	*store_tile(t_fractal *fract, const t_tile_key *key)
+{
+	const t_store_head	*h;
+	const t_store_level	*l;
+	long				i;
+
+	h = fract->store.head;
+	if (!h || h->type != key->type || h->c[0] != key->c[0]
+		|| h->c[1] != key->c[1] || h->max_iter != key->max_iter
+		|| h->flags != key->flags)
+		return (NULL);
+	l = h->level;
+	while (l < h->level + h->levels && l->spacing != key->spacing)
+		l++;
+	if (l == h->level + h->levels || fract->kernels[l->tier] != key->kernel
+		|| key->tx < l->tx || key->tx >= l->tx + l->nx
+		|| key->ty < l->ty || key->ty >= l->ty + l->ny)
+		return (NULL);
+	i = l->first + (key->ty - l->ty) * l->nx + key->tx - l->tx;
+	if (!__atomic_load_n(fract->store.done + i, __ATOMIC_ACQUIRE))
+		return (NULL);
+	return (fract->store.tiles + i);
+}
@@ -0,0 +1,200 @@
+#include "fract.h"
+
+static void	flush_points(t_tile *t)
+{
+	int	i;
+
+	if (t->batch.n == 0)
+		return ;
+	run_batch(t->fract, &t->batch);
+	i = 0;
+	while (i < t->batch.n)
+	{
+		t->iter[t->slot[i]] = t->batch.iter[i];
+		if (t->batch.flags & SMOOTH_COUNT)
+			t->smooth[t->slot[i]] = t->batch.smooth[i];
+		t->iterations += t->batch.iter[i];
+		i++;
+	}
+	t->batch.n = 0;
+}
+
+/*
+** Queues every not yet computed pixel of r = {x0, y0, x1, y1} (inclusive,
+** tile-local) and iterates them a full batch at a time. The last partial
+** batch stays queued until flush_points().
+*/
+static void	compute_rect(t_tile *t, int x0, int y0, int x1, int y1)
+{
+	t_fractal	*fract;
+	double		c[2];
+	int			x;
+
+	fract = t->fract;
+	while (y0 <= y1)
+	{
+		c[1] = fract->max_im - (t->rect[1] + y0) * fract->factors[1];
+		x = x0;
+		while (x <= x1)
+		{
+			if (t->iter[y0 * t->width + x] < 0)
+			{
+				c[0] = fract->min_re + (t->rect[0] + x) * fract->factors[0];
+				t->slot[t->batch.n] = y0 * t->width + x;
+				fract->formula->load(fract, &t->batch, t->batch.n++, c);
+				if (t->batch.n == BATCH_SIZE)
+					flush_points(t);
+			}
+			x++;
+		}
+		y0++;
+	}
+}
+
+/*
+** Iterates the border of r and returns its count when every border pixel
+** has the same one, or -1 otherwise.
+*/
+static int	border_value(t_tile *t, int r[4])
+{
+	int	value;
+	int	i;
+
+	compute_rect(t, r[0], r[1], r[2], r[1]);
+	compute_rect(t, r[0], r[3], r[2], r[3]);
+	compute_rect(t, r[0], r[1], r[0], r[3]);
+	compute_rect(t, r[2], r[1], r[2], r[3]);
+	flush_points(t);
+	value = t->iter[r[1] * t->width + r[0]];
+	i = r[0];
+	while (i <= r[2])
+	{
+		if (t->iter[r[1] * t->width + i] != value
+			|| t->iter[r[3] * t->width + i] != value)
+			return (-1);
+		i++;
+	}
+	i = r[1];
+	while (i <= r[3])
+	{
+		if (t->iter[i * t->width + r[0]] != value
+			|| t->iter[i * t->width + r[2]] != value)
+			return (-1);
+		i++;
+	}
+	return (value);
+}
+
+static void	fill_inside(t_tile *t, int r[4], int value)
+{
+	int	y;
+	int	x;
+
+	y = r[1] + 1;
+	while (y < r[3])
+	{
+		x = r[0] + 1;
+		while (x < r[2])
+		{
+			t->iter[y * t->width + x] = value;
+			t->smooth[y * t->width + x++] = value;
+		}
+		y++;
+	}
+}
+
+/*
+** Mariani-Silver: a rectangle whose border has a single iteration count is
+** filled with it, otherwise it is split in two across its longer side and
+** each half is handled the same way. Smooth counts vary inside a band, so
+** with them only rectangles of the set itself are filled, with max_iter
+** as their smooth count too. The halves share the split line, so every
+** pixel is computed at most once. Small rectangles are iterated in full.
+*/
+static void	subdivide(t_tile *t, int r[4])
+{
+	int	half[4];
+	int	value;
+
+	value = border_value(t, r);
+	if (value >= 0 && (!t->fract->smooth || value == t->fract->max_iter))
+	{
+		fill_inside(t, r, value);
+		return ;
+	}
+	if (r[2] - r[0] <= SUBDIVIDE_MIN || r[3] - r[1] <= SUBDIVIDE_MIN)
+	{
+		compute_rect(t, r[0], r[1], r[2], r[3]);
+		flush_points(t);
+		return ;
+	}
+	half[0] = r[0];
+	half[1] = r[1];
+	half[2] = r[2];
+	half[3] = r[3];
+	if (r[2] - r[0] >= r[3] - r[1])
+	{
+		half[2] = (r[0] + r[2]) / 2;
+		subdivide(t, half);
+		half[0] = half[2];
+		half[2] = r[2];
+	}
+	else
+	{
+		half[3] = (r[1] + r[3]) / 2;
+		subdivide(t, half);
+		half[1] = half[3];
+		half[3] = r[3];
+	}
+	subdivide(t, half);
+}
+
+/*
+** Full-resolution tile job used instead of render_tile() when subdivision
+** is enabled, with the same use of the tile cache. Iteration counts live
+** in a tile-local scratch array; -1 marks pixels that have not been
+** computed yet.
+*/
+void	subdivide_tile(t_fractal *fract, int tile)
+{
+	t_tile	t;
+	long	start;
+	int		r[4];
+	int		i;
+
+	t.fract = fract;
+	tile_rect(fract, tile, t.rect);
+	if (cache_fetch(fract, t.rect))
+	{
+		color_rect(fract, t.rect);
+		return ;
+	}
+	t.width = t.rect[2] - t.rect[0];
+	r[0] = 0;
+	r[1] = 0;
+	r[2] = t.width - 1;
+	r[3] = t.rect[3] - t.rect[1] - 1;
+	i = 0;
+	while (i < t.width * (r[3] + 1))
+		t.iter[i++] = -1;
+	start = stats_now();
+	t.iterations = 0;
+	init_batch(fract, &t.batch);
+	subdivide(&t, r);
+	stats_add(&fract->stats.iterations, t.iterations);
+	stats_add(&fract->stats.iterate, stats_now() - start);
+	i = 0;
+	while (i < t.width * (r[3] + 1))
+	{
+		fract->iters[(t.rect[1] + i / t.width) * fract->width
+			+ t.rect[0] + i % t.width] = t.iter[i];
+		if (fract->smooth)
+			fract->smooth_iters[(t.rect[1] + i / t.width) * fract->width
+				+ t.rect[0] + i % t.width] = t.smooth[i];
+		i++;
+	}
+	if (fract->orbits)
+		forget_orbits(fract, t.rect);
+	cache_store(fract, t.rect);
+	color_rect(fract, t.rect);
+}
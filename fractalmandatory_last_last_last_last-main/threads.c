@@ -0,0 +1,137 @@
+#include "fract.h"
+#include <unistd.h>
+
+/*
+** Whether a hook has changed the view or settings since the render thread
+** started its work. Pool workers test it before every tile, so a stale
+** frame is abandoned within one tile per thread. Without a window both
+** counters stay 0 and nothing is ever cancelled.
+*/
+int	render_cancelled(t_fractal *fract)
+{
+	return (__atomic_load_n(&fract->async.generation, __ATOMIC_RELAXED)
+		!= fract->async.started);
+}
+
+static void	run_tiles(t_fractal *fract, t_pool *pool, int id)
+{
+	long	start;
+	int		tile;
+
+	start = stats_now();
+	tile = __atomic_fetch_add(&pool->next_tile, 1, __ATOMIC_RELAXED);
+	while (tile < pool->num_tiles && !render_cancelled(fract))
+	{
+		pool->job(fract, tile);
+		tile = __atomic_fetch_add(&pool->next_tile, 1, __ATOMIC_RELAXED);
+	}
+	fract->stats.busy[id] += stats_now() - start;
+}
+
+/*
+** Workers sleep on `wake` until pool_run() bumps the generation, then pull
+** tiles off the shared counter until none are left. Pulling one tile at a
+** time keeps every core busy even when a few tiles sit inside the set and
+** cost max_iter per pixel while the rest escape almost immediately.
+*/
+void	*render_thread(void *arg)
+{
+	t_thread_data	*data;
+	t_pool			*pool;
+	int				seen;
+
+	data = (t_thread_data *)arg;
+	pool = &data->fract->pool;
+	seen = 0;
+	pthread_mutex_lock(&pool->lock);
+	while (1)
+	{
+		while (!pool->quit && pool->generation == seen)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		if (pool->quit)
+			break ;
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+		run_tiles(data->fract, pool, data->thread_id);
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return (NULL);
+}
+
+void	pool_init(t_fractal *fract)
+{
+	t_pool	*pool;
+	long	cores;
+
+	pool = &fract->pool;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->generation = 0;
+	pool->quit = 0;
+	pool->num_threads = 0;
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores < 1)
+		cores = 1;
+	if (cores > MAX_THREADS)
+		cores = MAX_THREADS;
+	while (pool->num_threads < cores)
+	{
+		pool->thread_data[pool->num_threads].fract = fract;
+		pool->thread_data[pool->num_threads].thread_id = pool->num_threads;
+		if (pthread_create(&pool->threads[pool->num_threads], NULL,
+				render_thread, &pool->thread_data[pool->num_threads]))
+			break ;
+		pool->num_threads++;
+	}
+}
+
+/*
+** Runs `job` once for every tile index in [0, num_tiles) and returns when
+** all of them are finished. Falls back to the calling thread when no worker
+** could be started.
+*/
+void	pool_run(t_fractal *fract, t_job job, int num_tiles)
+{
+	t_pool	*pool;
+	long	start;
+
+	pool = &fract->pool;
+	pool->job = job;
+	pool->num_tiles = num_tiles;
+	pool->next_tile = 0;
+	start = stats_now();
+	if (pool->num_threads == 0)
+		run_tiles(fract, pool, 0);
+	else
+	{
+		pthread_mutex_lock(&pool->lock);
+		pool->busy = pool->num_threads;
+		pool->generation++;
+		pthread_cond_broadcast(&pool->wake);
+		while (pool->busy > 0)
+			pthread_cond_wait(&pool->done, &pool->lock);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	fract->stats.pool += stats_now() - start;
+}
+
+void	pool_destroy(t_pool *pool)
+{
+	int	i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	i = 0;
+	while (i < pool->num_threads)
+		pthread_join(pool->threads[i++], NULL);
+	pool->num_threads = 0;
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+}
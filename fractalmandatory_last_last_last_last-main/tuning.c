@@ -0,0 +1,163 @@
+#include "fract.h"
+#include <math.h>
+
+/*
+** Without --iter, max_iter grows by AUTO_ITER_OCTAVE for every halving of
+** the span below AUTO_SPAN, times the scale the escape counts have settled
+** on, within AUTO_ITER_MIN and AUTO_ITER_MAX.
+*/
+void	tune_iter(t_fractal *fract)
+{
+	double	depth;
+	double	iter;
+
+	if (!fract->tuning.auto_iter)
+		return ;
+	depth = log2(AUTO_SPAN / (fract->max_re - fract->min_re));
+	iter = (AUTO_ITER_MIN + AUTO_ITER_OCTAVE * fmax(depth, 0.0))
+		* fract->tuning.scale;
+	fract->max_iter = (int)fmin(fmax(iter, AUTO_ITER_MIN), AUTO_ITER_MAX);
+}
+
+/*
+** Counts the samples of a pass at `step` over the whole image, and those
+** that escaped in the upper half of the range. Returns the highest count
+** of an escaped sample.
+*/
+static int	escape_counts(t_fractal *fract, int step, long count[2])
+{
+	int	top;
+	int	iter;
+	int	x;
+	int	y;
+
+	top = 0;
+	y = 0;
+	while (y < fract->height)
+	{
+		x = 0;
+		while (x < fract->width)
+		{
+			iter = fract->iters[y * fract->width + x];
+			count[0]++;
+			count[1] += iter < fract->max_iter && iter >= fract->max_iter / 2;
+			if (iter < fract->max_iter && iter > top)
+				top = iter;
+			x += step;
+		}
+		y += step;
+	}
+	return (top);
+}
+
+/*
+** When more than AUTO_TAIL of the samples escaped in the upper half of the
+** range, about as many again are likely still going at the cap and being
+** taken for the set, so max_iter doubles and the pass has to be redone.
+** When none got past a quarter of the range, the next view starts from
+** half as many. Returns 1 when max_iter was raised.
+*/
+static int	retune(t_fractal *fract, int step)
+{
+	long	count[2];
+	int		top;
+
+	count[0] = 0;
+	count[1] = 0;
+	top = escape_counts(fract, step, count);
+	if (top < fract->max_iter / 4 && fract->tuning.scale > AUTO_SCALE_MIN)
+		fract->tuning.scale /= 2.0;
+	if (count[1] <= AUTO_TAIL * count[0] || fract->max_iter >= AUTO_ITER_MAX)
+		return (0);
+	fract->tuning.scale *= 2.0;
+	tune_iter(fract);
+	return (1);
+}
+
+/*
+** The first pass of a new view: PREVIEW_STEP, or with --budget the finest
+** step predicted to fit in the budget, from the cost of the last preview
+** pass scaled to the current max_iter.
+*/
+int	first_step(t_fractal *fract)
+{
+	t_tuning	*t;
+	double		ms;
+	int			step;
+
+	t = &fract->tuning;
+	if (!t->budget_ms || t->sample_ns <= 0.0)
+		return (PREVIEW_STEP);
+	ms = t->sample_ns * fract->max_iter / t->sample_iter
+		* fract->width * fract->height / 1e6;
+	step = 1;
+	while (step < TILE_SIZE && ms > t->budget_ms)
+	{
+		step *= 2;
+		ms /= 4.0;
+	}
+	return (step);
+}
+
+/*
+** Called by the render thread after each pass of the progressive sequence
+** with the time it took. Preview passes never come from the cache, so
+** they give the cost of a sample of the view. The first pass of a view
+** also retunes max_iter; when it was raised the pass is continued from
+** the kept orbits, or without them done over. Returns the step of the
+** next pass, 0 once the frame is complete.
+*/
+int	next_pass(t_fractal *fract, long ns)
+{
+	long	samples;
+	int		step;
+
+	step = fract->refine;
+	samples = (long)((fract->width + step - 1) / step)
+		* ((fract->height + step - 1) / step);
+	if (step < fract->first_pass)
+		samples -= (long)((fract->width + 2 * step - 1) / (2 * step))
+			* ((fract->height + 2 * step - 1) / (2 * step));
+	if (step > 1 && samples > 0)
+	{
+		fract->tuning.sample_ns = (double)ns / samples;
+		fract->tuning.sample_iter = fract->max_iter;
+	}
+	if (step == fract->first_pass && fract->tuning.auto_iter
+		&& retune(fract, step))
+	{
+		if (!fract->orbits)
+			return (step);
+		fract->resume = step;
+	}
+	return (step / 2);
+}
+
+/*
+** Called after a pass was resumed. Retunes again like next_pass() and
+** returns the step to resume once more, or 0. A resumed complete frame
+** still needs its anti-aliasing.
+*/
+int	next_resume(t_fractal *fract)
+{
+	if (fract->tuning.auto_iter && retune(fract, fract->resume))
+		return (fract->resume);
+	if (fract->resume == 1 && !fract->refine)
+		fract->aa.pending = fract->aa.on;
+	return (0);
+}
+
+/*
+** Headless counterpart: settles max_iter on PREVIEW_STEP passes before the
+** full resolution one.
+*/
+void	tune_image(t_fractal *fract)
+{
+	if (!fract->tuning.auto_iter)
+		return ;
+	tune_iter(fract);
+	fract->blocks = 1;
+	render_pass(fract, PREVIEW_STEP, 0);
+	while (retune(fract, PREVIEW_STEP))
+		render_pass(fract, PREVIEW_STEP, 0);
+}
@@ -1,4 +1,5 @@
 #include "fract.h"
+#include <math.h>
 
 int	ft_strcmp(const char *s1, const char *s2)
 {
@@ -39,6 +40,19 @@ double	is_it_double(const char **s)
 	return (fraction / divisor);
 }
 
+static double	apply_exponent(const char *s, double res)
+{
+	double	exponent;
+	int		sign;
+
+	sign = 1;
+	if (*s == '-' || *s == '+')
+		if (*s++ == '-')
+			sign = -1;
+	exponent = is_it_int(&s);
+	return (res * pow(10.0, sign * exponent));
+}
+
 double	ft_atof(const char *str)
 {
 	double	res;
@@ -57,5 +71,7 @@ double	ft_atof(const char *str)
 		str++;
 		res += is_it_double(&str);
 	}
+	if (*str == 'e' || *str == 'E')
+		res = apply_exponent(str + 1, res);
 	return (res * sign);
 }
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "fract.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*
+** The views of the suite. The golden ones are rendered at
+** VERIFY_GOLDEN_SIZE and their files named after them.
+*/
+static const t_view	g_views[] = {
+{{"overview", "mandelbrot", "--iter", "256", NULL},
+	VIEW_SCALAR | VIEW_GOLDEN},
+{{"overview-double", "mandelbrot", "--iter", "256", "--precision", "double",
+	NULL}, VIEW_SCALAR},
+{{"overview-long", "mandelbrot", "--iter", "256", "--precision", "long",
+	NULL}, VIEW_SCALAR | VIEW_GOLDEN},
+{{"overview-smooth", "mandelbrot", "--iter", "500", "--smooth", NULL},
+	VIEW_SCALAR},
+{{"seahorse-valley", "mandelbrot", "--iter", "1000", "--center", "-0.75",
+	"0.1", "--span", "0.05", NULL}, VIEW_SCALAR},
+{{"minibrot-smooth", "mandelbrot", "--iter", "3000", "--center", "-1.7687",
+	"0.0017", "--span", "0.004", "--smooth", NULL},
+	VIEW_SCALAR | VIEW_GOLDEN},
+{{"minibrot-exact", "mandelbrot", "--iter", "3000", "--center", "-1.7687",
+	"0.0017", "--span", "0.004", "--exact", NULL}, VIEW_SCALAR},
+{{"deep-zoom", "mandelbrot", "--iter", "4000", "--center",
+	"-1.98554037165413048553143926719126985181116543463638", "0",
+	"--span", "1e-20", "--smooth", NULL}, VIEW_GOLDEN},
+{{"julia-dendrite", "julia", "0", "1", "--iter", "1000", NULL},
+	VIEW_SCALAR},
+{{"julia-spiral-smooth", "julia", "-0.7269", "0.1889", "--iter", "1000",
+	"--smooth", NULL}, VIEW_SCALAR | VIEW_GOLDEN},
+{{"julia-rabbit-double", "julia", "-0.123", "0.745", "--iter", "1000",
+	"--precision", "double", NULL}, VIEW_SCALAR},
+{{"burning-ship", "burning_ship", "--iter", "500", "--center", "-1.76",
+	"-0.03", "--span", "0.1", "--smooth", NULL}, VIEW_SCALAR | VIEW_GOLDEN},
+{{"burning-ship-float", "burning_ship", "--iter", "256", "--precision",
+	"float", NULL}, VIEW_SCALAR},
+{{"tricorn", "tricorn", "--iter", "500", "--smooth", NULL},
+	VIEW_SCALAR | VIEW_GOLDEN},
+{{"multibrot-5", "multibrot", "--power", "5", "--iter", "500", "--smooth",
+	NULL}, VIEW_SCALAR | VIEW_GOLDEN},
+{{"multibrot-long", "multibrot", "--iter", "256", "--precision", "long",
+	NULL}, VIEW_SCALAR},
+{{"newton", "newton", "--iter", "100", "--precision", "double", NULL},
+	VIEW_SCALAR | VIEW_GOLDEN}};
+
+/*
+** The scalar kernel of the element type the view was rendered with.
+*/
+static t_kernel	scalar_kernel(t_fractal *fract)
+{
+	int	precision;
+
+	precision = PREC_FLOAT;
+	while (precision < PREC_LONG && fract->iterate != fract->kernels[precision])
+		precision++;
+	return (fract->formula->kernels[precision][0]);
+}
+
+/*
+** Reference counts for the rendered view: every pixel on one thread
+** through the scalar kernel, at the coordinates render_row() gives it.
+** The shortcuts follow the view, since cycle detection may take a very
+** slowly escaping point for an interior one; views with --exact check
+** the shortcut-free path.
+*/
+static void	reference(t_fractal *fract, int *iter, float *smooth)
+{
+	t_kernel	kernel;
+	t_batch		b;
+	double		c[2];
+	int			x;
+	int			y;
+
+	kernel = scalar_kernel(fract);
+	y = -1;
+	while (++y < fract->height)
+	{
+		c[1] = fract->max_im - y * fract->factors[1];
+		x = 0;
+		while (x < fract->width)
+		{
+			init_batch(fract, &b);
+			while (b.n < BATCH_SIZE && x + b.n < fract->width)
+			{
+				c[0] = fract->min_re + (x + b.n) * fract->factors[0];
+				fract->formula->load(fract, &b, b.n, c);
+				b.n++;
+			}
+			kernel(&b);
+			if (b.flags & SMOOTH_COUNT)
+				smooth_batch(&b);
+			else if (fract->smooth)
+				plain_batch(&b);
+			while (b.n-- > 0)
+			{
+				iter[y * fract->width + x + b.n] = b.iter[b.n];
+				smooth[y * fract->width + x + b.n] = b.smooth[b.n];
+			}
+			x += BATCH_SIZE;
+		}
+	}
+}
+
+/*
+** Compares the rendered counts with the reference: integer counts must
+** match exactly, smooth values within VERIFY_SMOOTH_EPS. Prints one line
+** for the check and returns 1 when it fails.
+*/
+int	compare_counts(t_fractal *fract, const char *name, int *iter,
+		float *smooth)
+{
+	double	err;
+	long	bad;
+	long	first;
+	long	i;
+
+	err = 0.0;
+	bad = 0;
+	first = -1;
+	i = -1;
+	while (++i < (long)fract->width * fract->height)
+	{
+		if (fract->smooth)
+			err = fmax(err, fabs(fract->smooth_iters[i] - smooth[i]));
+		if (fract->iters[i] != iter[i] && first < 0)
+			first = i;
+		bad += fract->iters[i] != iter[i];
+	}
+	printf("%s  %-32s %8ld mismatched  smooth error %.2e\n",
+		(bad || err > VERIFY_SMOOTH_EPS) ? "FAIL" : "ok  ", name, bad, err);
+	if (first >= 0)
+		printf("      first at (%ld, %ld): %d, expected %d\n",
+			first % fract->width, first / fract->width, fract->iters[first],
+			iter[first]);
+	return (bad || err > VERIFY_SMOOTH_EPS);
+}
+
+/*
+** Renders the view with the fast paths, then again with rectangle
+** subdivision, and checks both against the reference.
+*/
+static int	check_view(t_fractal *fract, const char *name, int *iter,
+		float *smooth)
+{
+	char	label[64];
+	int		status;
+
+	fract->subdivide = 0;
+	render_image(fract);
+	reference(fract, iter, smooth);
+	snprintf(label, sizeof(label), "%s", name);
+	status = compare_counts(fract, label, iter, smooth);
+	fract->subdivide = 1;
+	render_image(fract);
+	snprintf(label, sizeof(label), "%s --subdivide", name);
+	status |= compare_counts(fract, label, iter, smooth);
+	return (status);
+}
+
+/*
+** Sets up the view of a suite at `size`, view[0] standing for argv[0],
+** and runs check on it with room for a reference image. A view with
+** --store reads its tiles from the store, framed like render does it.
+*/
+int	verify_view(const char *const *view, const char *size, t_check check)
+{
+	t_fractal	fract;
+	t_options	opt;
+	const char	*argv[16];
+	void		*ref[2];
+	int			argc;
+	int			status;
+
+	argc = 0;
+	while (view[argc])
+	{
+		argv[argc] = view[argc];
+		argc++;
+	}
+	argv[argc++] = "--size";
+	argv[argc++] = size;
+	argv[argc] = NULL;
+	init_fractal(&fract);
+	if (parse_args(argc, (char **)argv, &fract, &opt)
+		|| (opt.store && store_open(&fract.store, opt.store)))
+		return (1);
+	if (opt.store)
+	{
+		deep_update(&fract);
+		snap_view(&fract);
+	}
+	if (alloc_buffer(&fract))
+		return (1);
+	ref[0] = malloc((size_t)fract.width * fract.height * sizeof(int));
+	ref[1] = malloc((size_t)fract.width * fract.height * sizeof(float));
+	status = !ref[0] || !ref[1];
+	pool_init(&fract);
+	if (!status)
+		status = check(&fract, view[0], ref[0], ref[1]);
+	pool_destroy(&fract.pool);
+	free(ref[0]);
+	free(ref[1]);
+	free(fract.addr);
+	free(fract.iters);
+	free(fract.smooth_iters);
+	aa_free(&fract.aa);
+	store_close(&fract.store);
+	deep_free(&fract);
+	palette_free(&fract.colors);
+	return (status);
+}
+
+const t_view	*verify_views(int *count)
+{
+	*count = sizeof(g_views) / sizeof(g_views[0]);
+	return (g_views);
+}
+
+/*
+** `./fractol verify [--size WxH] [--record]`: renders a fixed suite of
+** views headless through the vector kernels, the pool and the shortcuts,
+** and once more with rectangle subdivision, and checks the counts pixel by
+** pixel against a brute-force scalar render. Then checks the golden views
+** against their checked-in counts, or with --record rewrites those. Exits
+** with 1 when any check fails.
+*/
+int	verify(int argc, char **argv)
+{
+	const char	*size;
+	int			record;
+	int			status;
+	int			n;
+
+	size = VERIFY_SIZE;
+	record = argc == 2 && ft_strcmp(argv[1], "--record") == 0;
+	if (argc == 3 && ft_strcmp(argv[1], "--size") == 0)
+		size = argv[2];
+	else if (argc != 1 && !record)
+	{
+		printf("Error: Invalid option '%s'\n\n", argv[1]);
+		print_usage();
+		return (1);
+	}
+	status = 0;
+	n = 0;
+	while (!record && n < (int)(sizeof(g_views) / sizeof(g_views[0])))
+	{
+		if (g_views[n].checks & VIEW_SCALAR)
+			status |= verify_view(g_views[n].argv, size, check_view);
+		n++;
+	}
+	status |= golden_suite(record);
+	printf("%s\n", status ? "verify: FAILED" : "verify: all checks passed");
+	return (status);
+}
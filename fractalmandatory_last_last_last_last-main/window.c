@@ -0,0 +1,175 @@
+#include "fract.h"
+#include "minilibx-linux/mlx.h"
+#include "minilibx-linux/mlx_int.h"
+#include <unistd.h>
+
+/*
+** mlx_new_window() pins both the minimum and maximum size hints to the
+** initial size. Keep only the minimum so the window manager lets the user
+** resize the window; resize_hook() follows with a matching image.
+*/
+void	allow_resize(t_fractal *fract)
+{
+	XSizeHints	hints;
+
+	hints.flags = PMinSize;
+	hints.min_width = 2;
+	hints.min_height = 2;
+	XSetWMNormalHints(((t_xvar *)fract->mlx)->display,
+		((t_win_list *)fract->win)->window, &hints);
+}
+
+/*
+** Puts the front image on the window, with the HUD over it when it is
+** shown. Called with the async lock held. MiniLibX keeps its images in
+** shared memory when the server allows it; those go straight to the
+** window in one server-side copy instead of through the pixmap MiniLibX
+** keeps behind each image. The server reads shared memory only when it
+** gets to the request, so wait for it before the lock is released and
+** the render thread may draw into this image again.
+*/
+void	present(t_fractal *fract)
+{
+	t_xvar	*xvar;
+	t_img	*img;
+	long	start;
+
+	start = stats_now();
+	xvar = fract->mlx;
+	img = fract->async.img[fract->async.front];
+	if (img->type == MLX_TYPE_SHM)
+		XShmPutImage(xvar->display, ((t_win_list *)fract->win)->window,
+			((t_win_list *)fract->win)->gc, img->image, 0, 0, 0, 0,
+			img->width, img->height, False);
+	else
+		mlx_put_image_to_window(fract->mlx, fract->win, img, 0, 0);
+	if (fract->show_info)
+		draw_hud(fract);
+	if (img->type != MLX_TYPE_XIMAGE)
+		XSync(xvar->display, False);
+	fract->stats.blit += stats_now() - start;
+	fract->stats.frames++;
+}
+
+/*
+** Swaps in images of the new size. The pixel size is kept, so growing
+** the window reveals more of the plane rather than stretching it.
+*/
+int	resize_fractal(t_fractal *fract, int width, int height)
+{
+	double	center[2];
+	double	span;
+
+	if (alloc_iters(fract, width, height)
+		|| alloc_orbits(fract, width, height)
+		|| async_images(fract, width, height))
+		return (1);
+	center[0] = (fract->min_re + fract->max_re) / 2.0;
+	center[1] = (fract->min_im + fract->max_im) / 2.0;
+	span = (fract->max_re - fract->min_re) * width / fract->width;
+	fract->width = width;
+	fract->height = height;
+	set_view(fract, center[0], center[1], span);
+	return (0);
+}
+
+/*
+** ConfigureNotify carries no arguments through MiniLibX, so ask X for the
+** current size. Moves also land here and are ignored.
+*/
+int	resize_hook(t_fractal *fract)
+{
+	XWindowAttributes	attr;
+
+	if (!XGetWindowAttributes(((t_xvar *)fract->mlx)->display,
+			((t_win_list *)fract->win)->window, &attr))
+		return (0);
+	if (attr.width < 2 || attr.height < 2 || attr.width > MAX_SIZE
+		|| attr.height > MAX_SIZE
+		|| (long)attr.width * attr.height > MAX_PIXELS)
+		return (0);
+	if (attr.width == fract->width && attr.height == fract->height)
+		return (0);
+	stop_render(fract);
+	if (resize_fractal(fract, attr.width, attr.height) == 0)
+		render_fractal(fract);
+	return (0);
+}
+
+/*
+** Interactive entry point: restarts the progressive sequence for the
+** current view, from a coarse preview, or at full resolution straight
+** away when the tile cache holds the whole view. The render thread runs
+** it once loop_hook() hands it over; whatever was still pending for the
+** previous view is dropped.
+*/
+void	render_fractal(t_fractal *fract)
+{
+	snap_view(fract);
+	tune_iter(fract);
+	fract->first_pass = first_step(fract);
+	if (cache_covers(fract))
+		fract->first_pass = 1;
+	fract->refine = fract->first_pass;
+	fract->blocks = 1;
+	fract->warp = 0;
+	fract->num_strips = 0;
+	fract->resume = 0;
+	fract->aa.pending = 0;
+}
+
+/*
+** Instant preview for a zoom, done here rather than in mouse_hook() so a
+** burst of wheel events warps the saved frame only once.
+*/
+static void	start_view(t_fractal *fract)
+{
+	fract->warp = 0;
+	snap_view(fract);
+	tune_iter(fract);
+	if (cache_covers(fract))
+		render_fractal(fract);
+	else
+		reproject(fract);
+}
+
+/*
+** MiniLibX calls this whenever the event queue is empty. It shows the
+** newest frame the render thread published and, once the thread is idle,
+** hands it whatever work the hooks left pending. Color cycling recolors
+** complete frames only. Sleeps briefly when there is nothing to do, as
+** mlx_loop() spins when a loop hook is installed.
+*/
+int	loop_hook(t_fractal *fract)
+{
+	t_async	*a;
+	int		idle;
+
+	a = &fract->async;
+	if (fract->warp)
+		start_view(fract);
+	pthread_mutex_lock(&a->lock);
+	idle = !a->busy;
+	if (idle && stats_tick(fract, 0) && fract->show_info)
+		a->redraw = 1;
+	if (a->ready >= 0)
+		a->front = a->ready;
+	if (a->ready >= 0 || a->redraw)
+		present(fract);
+	a->ready = -1;
+	a->redraw = 0;
+	pthread_mutex_unlock(&a->lock);
+	if (idle && render_pending(fract))
+		start_render(fract);
+	else if (idle && fract->animate)
+	{
+		fract->color_shift += CYCLE_STEP;
+		if (fract->color_shift >= 1.0)
+			fract->color_shift -= 1.0;
+		recolor(fract);
+		publish(fract);
+	}
+	else
+		usleep(IDLE_SLEEP_US);
+	return (0);
+}